@@ -18,7 +18,7 @@
 #endif
 
 /* macros --------------------------------------------------------------------*/
-#define PWM_BL_STOP  U8_MAX
+#define PWM_BL_STOP  U16_MAX
 
 
 /* types ---------------------------------------------------------------------*/
@@ -37,6 +37,33 @@ typedef enum
     BL_IS_RUNNING
 } BL_RUNSTATE_t;
 
+/**
+ * @brief Motor state machine states, see @ref statem.
+ */
+typedef enum
+{
+    BL_ST_RESET,  /**< Re-initialize and clear faults */
+    BL_ST_READY,  /**< Stopped, waiting for the speed input */
+    BL_ST_CATCH,  /**< Bridge off, sensing a spinning rotor */
+    BL_ST_ALIGN,  /**< Rotor alignment */
+    BL_ST_RAMP,   /**< Open-loop start ramp */
+    BL_ST_RUN,    /**< Running */
+    BL_ST_FAULT,  /**< Stopped on fault, until reset */
+    BL_ST_COUNT
+} BL_STATE_t;
+
+/**
+ * @brief Open-loop timing table tuning status.
+ */
+typedef enum
+{
+    BL_TUNE_IDLE,   /**< Not tuning */
+    BL_TUNE_ARMED,  /**< Sweep starts once running */
+    BL_TUNE_SWEEP,  /**< Sweep in progress, the speed input is overridden */
+    BL_TUNE_DONE,   /**< Tuned table applied, to be saved */
+    BL_TUNE_FAIL    /**< Sweep aborted or the table not plausible */
+} BL_TUNE_t;
+
 /**
   * @brief Accessor for commutation period.
   *
@@ -47,14 +74,21 @@ uint16_t get_commutation_period(void);
 void BLDC_Spd_inc(void);
 void BLDC_Spd_dec(void);
 
-void BLDC_PWMDC_Set(uint8_t dc);
+void BLDC_PWMDC_Set(uint16_t dc);
 uint16_t BLDC_PWMDC_Get(void);
 
 void BL_reset(void);
+void BL_stop(void);
 
 BL_RUNSTATE_t BL_get_state(void);
+BL_STATE_t BL_get_sm_state(void);
+uint16_t BL_get_state_time(BL_STATE_t state);
 uint8_t BL_get_ct_mode(void);
 
+void BL_Tune_arm(void);
+BL_TUNE_t BL_Tune_status(void);
+void BL_Tune_ack(void);
+
 /**
  * @brief Periodic state machine update.
  *
@@ -0,0 +1,28 @@
+/**
+  ******************************************************************************
+  * @file crc8.h
+  * @brief CRC-8
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  */
+#ifndef CRC8_H
+#define CRC8_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+
+#ifdef UNIT_TEST
+#include <stdint.h>
+#endif
+
+
+/*
+ * prototypes
+ */
+
+uint8_t Crc8(const uint8_t * p_data, uint8_t len);
+
+
+#endif // CRC8_H
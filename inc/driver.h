@@ -57,16 +57,35 @@ void Driver_Step(void);
 void Driver_Update(void);
 
 uint16_t Driver_Get_ADC(void);
+#if defined( ZC_TIMING_ENABLED )
+void Driver_Set_ZC_ref(uint16_t ref);
+uint16_t Driver_Get_ZC_tm(void);
+#endif
 uint16_t Driver_Get_Back_EMF_Avg(void);
 
+void Driver_ADC_calibrate(void);
+
 void Driver_on_PWM_edge(void);
 void Driver_on_ADC_conv(void);
 
 void Driver_on_capture_rise(void);
 void Driver_on_capture_fall(void);
+void Driver_on_servo_compare(void);
+void Driver_on_servo_edge(uint8_t level);
 
 uint16_t Driver_get_pulse_perd(void);
 uint16_t Driver_get_pulse_dur(void);
+uint16_t Driver_Get_latency(void);
+uint16_t Driver_Get_latency_max(void);
+
+uint16_t Driver_Get_Current(void);
+void Driver_on_PWM_break(void);
+uint8_t Driver_Get_PWM_breaks(void);
+
+void Driver_Catch_arm(uint8_t enable);
+uint8_t Driver_Catch_motion(void);
+uint8_t Driver_Catch_get(uint32_t * p_perd, uint32_t * p_elapsed);
+void Driver_Set_qsector(uint8_t qsector, uint16_t elapsed);
 
 
 #endif // DRIVER_H
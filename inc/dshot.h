@@ -0,0 +1,83 @@
+/**
+  ******************************************************************************
+  * @file dshot.h
+  * @brief DShot digital throttle protocol
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  */
+#ifndef DSHOT_H
+#define DSHOT_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+
+#ifdef UNIT_TEST
+#include <stdint.h>
+#endif
+
+/*
+ * defines
+ */
+
+#define DSHOT_FRAME_BITS   16
+
+// 11-bit throttle value: 0 is disarmed, 1-47 commands, 48-2047 throttle
+#define DSHOT_CMD_MAX      47
+#define DSHOT_THROTTLE_MIN 48
+#define DSHOT_THROTTLE_MAX 2047
+
+// throttle [48:2047] scaled to the duty-cycle command [0:DC_100PCNT) i.e.
+// 2000 steps << 5 == 250 << DC_SH
+#define DSHOT_DC_SH        5
+#define DSHOT_DC( _THR_ )  ( (uint16_t)( ( (_THR_) - DSHOT_THROTTLE_MIN ) << DSHOT_DC_SH ) )
+
+// bidirectional telemetry response: 16-bit frame GCR coded to 20 bits, plus
+// start bit
+#define DSHOT_TELEM_BITS   21
+
+// eRPM value (period exponent and mantissa) sent with the motor stopped
+#define DSHOT_ERPM_STOPPED 0x0FFF
+
+/*
+ * types
+ */
+
+/**
+ * @brief DShot special commands (value 1-47 with throttle 0), the subset
+ *  handled by this firmware
+ */
+typedef enum
+{
+  DSHOT_CMD_MOTOR_STOP = 0,
+  DSHOT_CMD_BEEP1 = 1,
+  DSHOT_CMD_ESC_INFO = 6,
+  DSHOT_CMD_SPIN_DIRECTION_1 = 7,
+  DSHOT_CMD_SPIN_DIRECTION_2 = 8,
+  DSHOT_CMD_SAVE_SETTINGS = 12,
+  DSHOT_CMD_NONE = 0xFF
+} dshot_cmd_t;
+
+
+/*
+ * prototypes
+ */
+
+uint16_t Dshot_crc(uint16_t value);
+uint16_t Dshot_encode(uint16_t value, uint8_t telem);
+int16_t Dshot_decode(uint16_t frame, uint8_t * p_telem);
+
+uint16_t Dshot_erpm_encode(uint16_t period_us);
+uint32_t Dshot_telem_encode(uint16_t value);
+
+uint8_t Dshot_on_bit(uint16_t rise, uint16_t fall);
+void Dshot_on_compare(void);
+void Dshot_Update(void);
+
+uint16_t Dshot_Get_throttle(void);
+dshot_cmd_t Dshot_Get_command(void);
+uint8_t Dshot_Get_telem_req(void);
+
+
+#endif // DSHOT_H
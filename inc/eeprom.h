@@ -0,0 +1,37 @@
+/**
+  ******************************************************************************
+  * @file eeprom.h
+  * @brief Data EEPROM records
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  */
+#ifndef EEPROM_H
+#define EEPROM_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+
+
+/*
+ * defines
+ */
+
+// record offsets in the data EEPROM (each record is followed by its CRC byte),
+// the smallest device (S003) has 128 bytes
+#define EE_OFFS_THROTTLE   0x00  // learned throttle range
+#define EE_OFFS_CURVE      0x10  // throttle curve
+#define EE_OFFS_OL_TABLE   0x30  // tuned open-loop timing table
+#define EE_OFFS_END        0x80
+
+
+/*
+ * prototypes
+ */
+
+uint8_t Eeprom_Load(uint8_t offs, void * p_rec, uint8_t len);
+uint8_t Eeprom_Save(uint8_t offs, const void * p_rec, uint8_t len);
+
+
+#endif // EEPROM_H
@@ -38,7 +38,8 @@ typedef enum
     FAULT_0 = 1,
     FAULT_1 = 2,
     VOLTAGE_NG = 4,
-    THROTTLE_HI = 8
+    THROTTLE_HI = 8,
+    CURRENT_NG = 16
 } faultm_ID_t;
 
 /**
@@ -48,6 +48,45 @@
 #define GETCHAR_PROTOTYPE int getchar (void)
 #endif /* _RAISONANCE_ */
 
+/**
+ * @brief Commutation timer counter and pending-update flag, for timestamping
+ * within the commutation period (read counter high byte first, see data sheet)
+ */
+#if defined( S105_DEV ) || defined( S105_DISCOVERY )
+#define MCU_COMM_TIMER_CNT()  TIM3_GetCounter()
+#define MCU_COMM_TIMER_UIF()  ( 0 != ( TIM3->SR1 & TIM3_SR1_UIF ) )
+#else
+#define MCU_COMM_TIMER_CNT()  TIM1_GetCounter()
+#define MCU_COMM_TIMER_UIF()  ( 0 != ( TIM1->SR1 & TIM1_SR1_UIF ) )
+#endif
+
+/**
+ * @brief PWM timer update flag, for synchronizing to the PWM without the ISR,
+ * and counter (PWM_CNT_US counts per us)
+ */
+#if defined( S105_DEV )
+#define MCU_PWM_TIMER_UIF()      ( 0 != ( TIM1->SR1 & TIM1_SR1_UIF ) )
+#define MCU_PWM_TIMER_UIF_CLR()  ( TIM1->SR1 = (uint8_t)( ~TIM1_SR1_UIF ) )
+#define MCU_PWM_TIMER_CNT()      TIM1_GetCounter()
+#else
+#define MCU_PWM_TIMER_UIF()      ( 0 != ( TIM2->SR1 & TIM2_SR1_UIF ) )
+#define MCU_PWM_TIMER_UIF_CLR()  ( TIM2->SR1 = (uint8_t)( ~TIM2_SR1_UIF ) )
+#define MCU_PWM_TIMER_CNT()      TIM2_GetCounter()
+#endif
+
+/**
+ * @brief Servo capture timer counter, and servo pin level when driven as output
+ */
+#if defined( S105_DEV )
+#define MCU_SERVO_TIMER_CNT()  TIM2_GetCounter()
+#elif defined( S105_DISCOVERY )
+#define MCU_SERVO_TIMER_CNT()  TIM1_GetCounter()
+#endif
+
+#define MCU_SERVO_PIN_SET( _LVL_ ) \
+  ( (0 != (_LVL_)) ? (SERVO_GPIO_PORT->ODR |= SERVO_GPIO_PIN) \
+                   : (SERVO_GPIO_PORT->ODR &= (uint8_t)~SERVO_GPIO_PIN) )
+
 /* Public variables  ---------------------------------------------------------*/
 
 /* Private variables ---------------------------------------------------------*/
@@ -61,6 +100,17 @@ void UARTputs(char *message);
 void MCU_Init(void);
 
 void MCU_set_comm_timer(uint16_t);
+void MCU_phase_comm_timer(uint16_t, uint16_t);
+
+void MCU_set_capture_fast(uint8_t fast);
+uint16_t MCU_servo_tm(uint32_t comm_tm);
+
+void MCU_uart_tx_start(const uint8_t * p_buf, uint8_t len);
+uint8_t MCU_uart_tx_busy(void);
+void MCU_uart_on_tx(void);
+
+void MCU_set_servo_output(uint8_t output);
+void MCU_set_servo_compare(uint8_t enable, uint16_t tm);
 
 
 #endif // MCU_STM8S
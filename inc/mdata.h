@@ -16,6 +16,20 @@
  * defines
  */
 
+// tuned open-loop timing table: knots evenly spaced over the duty-cycle range
+// of the tuning sweep (the timing error must be plausible over the range)
+#define OL_TUNE_KNOTS     9
+
+#if !defined( OL_TUNE_DC_MIN )
+#define OL_TUNE_DC_MIN    ( DC_100PCNT / 5 )        // 20%
+#endif
+#if !defined( OL_TUNE_DC_MAX )
+#define OL_TUNE_DC_MAX    ( (DC_100PCNT / 5) * 3 )  // 60%
+#endif
+
+#define OL_TUNE_DC_STEP   ( (OL_TUNE_DC_MAX - OL_TUNE_DC_MIN) / (OL_TUNE_KNOTS - 1) )
+
+#define OL_TUNE_DC( _KNOT_ )  ( OL_TUNE_DC_MIN + ((_KNOT_) * OL_TUNE_DC_STEP) )
 
 
 /*
@@ -30,6 +44,13 @@
  * prototypes
  */
 uint16_t Get_OL_Timing(uint16_t);
+uint16_t Get_OL_Dutycycle(uint16_t ctm);
+
+void Mdata_Init(void);
+uint8_t Mdata_Set(const uint16_t * p_knots);
+uint8_t Mdata_Save(void);
+uint8_t Mdata_Clear(void);
+uint16_t Mdata_Get(uint8_t knot);
 
 
 #endif // MDATA_H
@@ -0,0 +1,52 @@
+/**
+  ******************************************************************************
+  * @file median3.h
+  * @brief Median-of-3 filter
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  */
+#ifndef MEDIAN3_H
+#define MEDIAN3_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+
+#ifdef UNIT_TEST
+#include <stdint.h>
+#endif
+
+
+/*
+ * defines
+ */
+
+#define MIN16(a, b)  ( (a) < (b) ? (a) : (b) )
+#define MAX16(a, b)  ( (a) > (b) ? (a) : (b) )
+
+
+/*
+ * types
+ */
+
+/**
+ * @brief Previous 2 samples of the median-of-3 filter.
+ */
+typedef struct
+{
+  uint16_t s0;
+  uint16_t s1;
+  uint8_t  seeded;  /**< FALSE until the first sample (zero-initialized) */
+} median3_t;
+
+
+/*
+ * prototypes
+ */
+
+void Median3_Reset(median3_t * p_hist);
+uint16_t Median3(median3_t * p_hist, uint16_t sample);
+
+
+#endif // MEDIAN3_H
@@ -0,0 +1,54 @@
+/**
+  ******************************************************************************
+  * @file pi_ctrl.h
+  * @brief Fixed-point PI controller
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  */
+#ifndef PI_CTRL_H
+#define PI_CTRL_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+
+#ifdef UNIT_TEST
+#include <stdint.h>
+#endif
+
+
+/*
+ * defines
+ */
+
+// fractional bits of the gains and of the integrator
+#define PI_GAIN_SH  8
+
+
+/*
+ * types
+ */
+
+/**
+ * @brief PI controller parameters and state.
+ */
+typedef struct
+{
+  int16_t kp;       /**< Proportional gain, PI_GAIN_SH fractional bits */
+  int16_t ki;       /**< Integral gain per update, PI_GAIN_SH fractional bits */
+  int16_t out_min;  /**< Output limits, the integrator is held within */
+  int16_t out_max;
+  int32_t integ;    /**< Integrator, PI_GAIN_SH fractional bits */
+} pi_ctrl_t;
+
+
+/*
+ * prototypes
+ */
+
+void PI_ctrl_Reset(pi_ctrl_t * p_pi, int16_t out);
+int16_t PI_ctrl_Update(pi_ctrl_t * p_pi, int16_t err);
+
+
+#endif // PI_CTRL_H
@@ -0,0 +1,41 @@
+/**
+  ******************************************************************************
+  * @file scope.h
+  * @brief Triggered capture of raw back-EMF samples
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  */
+#ifndef SCOPE_H
+#define SCOPE_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+
+
+/*
+ * types
+ */
+
+/**
+ * @brief Capture trigger sources
+ */
+typedef enum
+{
+  SCOPE_TRIG_FAULT, // any fault status bit set
+  SCOPE_TRIG_STEP,  // commutation step change into the trigger step
+  SCOPE_TRIG_ERROR  // magnitude of the timing error exceeds threshold
+} scope_trig_t;
+
+
+/*
+ * prototypes
+ */
+
+void Scope_Arm(scope_trig_t trig);
+void Scope_Sample(uint16_t adc, uint16_t tstamp);
+uint8_t Scope_Dump(void);
+
+
+#endif // SCOPE_H
@@ -24,9 +24,12 @@ uint16_t Seq_Get_bemfR(void);
 uint16_t Seq_Get_bemfF(void);
 
 uint16_t Seq_Get_Vbatt(void);
+uint8_t Seq_Get_Step(void);
 int16_t Seq_get_timing_error(void);
 int8_t Seq_get_timing_error_p(void);
 void Sequence_Step(void);
+void Seq_Hold(uint8_t hold);
+void Seq_Set_step(uint8_t step);
 
 
 #endif // SEQUENCE_H
@@ -25,9 +25,40 @@
 // advise enabling this, so long as it is working (not triggering fault positives)
 //#define UNDERVOLTAGE_FAULT_ENABLED
 
-// apparently this is not working (6/7/2021)
+// closed-loop commutation timing (PI correction of the open-loop table timing
+// with fallback to open-loop if the back-EMF is not plausible, see BLDC_sm.c)
 //#define CLMODE_ENABLED
 
+// RPM governor: the speed input is a target eRPM and the duty-cycle is
+// controlled from the measured commutation period (requires CLMODE_ENABLED)
+//#define GOVERNOR_ENABLED
+
+// open-loop timing table auto-tuning: a sweep of the duty-cycle in closed-loop
+// measures the motor, and the table is stored in the data EEPROM (requires
+// CLMODE_ENABLED, see mdata.c)
+//#define OL_TUNE_ENABLED
+
+// catch a spinning (windmilling) rotor: at start the back-EMF is sensed with
+// the bridge off and the commutation is synchronized to the rotor, otherwise
+// the start is from rest (alignment and start ramp), see BLDC_sm.c
+//#define CATCH_ENABLED
+
+// scale the commanded duty-cycle by Vnominal/Vbatt so that a given throttle
+// setting yields the same speed as the battery voltage sags
+//#define VBATT_COMP_ENABLED
+
+// closed-loop timing error from the back-EMF zero-crossing time, interpolated
+// between the timestamped ADC samples, instead of the ratio of the back-EMF
+// samples (see sequence.c)
+//#define ZC_TIMING_ENABLED
+
+// reject single-sample outliers (switching spikes) in the back-EMF samples
+// by median-of-3 over consecutive sectors before the averaging
+//#define BEMF_MEDIAN_FILT
+
+// KISS ESC telemetry frame on the UART (the terminal logger is not printed)
+//#define TELEM_ENABLED
+
 /**
  * the STM8 variant is defined in the project file, along with the appropriate 
  * compiler settings for the particular MCU (memory model etc.)
@@ -54,6 +85,25 @@
 
   #define UNDERVOLTAGE_FAULT_ENABLED
 
+// AIN4, B4 - shunt amplifier output
+  #define ISENSE_IN_PORT     GPIOB
+  #define ISENSE_IN_PIN      GPIO_PIN_4
+  #define ISENSE_ADC_CHANNEL ADC1_CHANNEL_4
+
+// TIM1 drives PWM on this board so the over-current comparator output can be
+// routed to TIM1_BKIN (E3) for cycle-by-cycle limiting in hardware
+  #define HAS_PWM_BKIN
+
+// requires shunt, amplifier and comparator on the power stage
+//  #define CURRENT_SENSE_ENABLED
+
+// back-EMF capture to RAM for streaming to host (tools/scope.py)
+//  #define SCOPE_ENABLED
+
+// DShot throttle on the servo input (replaces the servo pulse), see dshot.c
+//  #define DSHOT_ENABLED
+//  #define DSHOT_BIDIR     // eRPM telemetry response on the throttle line
+
 #elif defined ( S105_DISCOVERY )
 /*
  * S105 Discovery board can't use TIM1 for PWM (unless solder bridges connecting the
@@ -79,6 +129,13 @@
 
   #define UNDERVOLTAGE_FAULT_ENABLED
 
+// back-EMF capture to RAM for streaming to host (tools/scope.py)
+//  #define SCOPE_ENABLED
+
+// DShot throttle on the servo input (replaces the servo pulse), see dshot.c
+//  #define DSHOT_ENABLED
+//  #define DSHOT_BIDIR     // eRPM telemetry response on the throttle line
+
 #elif defined ( S003_DEV )
 /*
  * s003 does not have TIM3. TIM2 drives PWM/control, TIM1 drives commutation step.
@@ -95,19 +152,41 @@
   #define LED_GPIO_PORT    GPIOB
   #define LED_GPIO_PIN     GPIO_PIN_5
 
-// invalid .. no timer avilable ?
-  #define SERVO_GPIO_PORT  (GPIO_TypeDef *)-1
-  #define SERVO_GPIO_PIN   (uint8_t)-1
+// no timer available for input capture, the servo pulse edges are timestamped
+// in the EXTI ISR (EXTI sensitivity is set for port A, see Servo_CC_setup)
+  #define SERVO_GPIO_PORT  GPIOA
+  #define SERVO_GPIO_PIN   GPIO_PIN_2
 
-//  #define HAS_SERVO_INPUT // no timer available?
+  #define HAS_SERVO_INPUT
 //  #define SPI_ENABLED     // can't fit SPI in 8k
 //  #define UNDERVOLTAGE_FAULT_ENABLED
+//  #define SCOPE_ENABLED   // not enough RAM for the capture buffer
 #endif
 
 #if defined( SPI_ENABLED )
   #define SPI_CONTROLLER
 #endif
 
+#if defined( DSHOT_ENABLED ) && !defined( HAS_SERVO_INPUT )
+  #error "DShot requires the servo input capture"
+#endif
+
+#if defined( DSHOT_ENABLED ) && defined( S003_DEV )
+  #error "DShot requires timer input capture, not the S003 EXTI servo input"
+#endif
+
+#if defined( DSHOT_BIDIR ) && !defined( DSHOT_ENABLED ) && !defined( UNIT_TEST )
+  #error "Bidirectional DShot requires DSHOT_ENABLED"
+#endif
+
+#if defined( GOVERNOR_ENABLED ) && !defined( CLMODE_ENABLED )
+  #error "The RPM governor requires CLMODE_ENABLED"
+#endif
+
+#if defined( OL_TUNE_ENABLED ) && !defined( CLMODE_ENABLED )
+  #error "Open-loop table tuning requires CLMODE_ENABLED"
+#endif
+
 #define SPI_RX_BUF_SZ  16 // 256 // tmp
 
 
@@ -138,12 +217,35 @@
 
 #define CTIME_SCALAR 2
 
+/*
+ * Commutation timer counts per us, i.e. fMASTER over the prescaler set in
+ * MCU_set_comm_timer() (2 @ 16Mhz, 1 @ 8Mhz). The commutation period is 1/4
+ * sector, 24 per electrical cycle.
+ */
+#ifdef CLOCK_16
+  #define COMM_CNT_US    ( 16 / 2 )
+#else
+  #define COMM_CNT_US    ( 8 / 1 )
+#endif
+
+#define COMM_QSECT_PER_CYCLE  24
+
+// eRPM/100 = COMM_ERPM100_NUM / commutation period, and vice versa
+#define COMM_ERPM100_NUM  ( (600000UL * COMM_CNT_US) / COMM_QSECT_PER_CYCLE )
+
 
 /*
  * (un)comment macro to set PWM 8 Khz or ?
  */
 #define PWM_8K
 
+/*
+ * (un)comment macro for high-resolution PWM: the PWM timer is clocked at
+ * fMASTER (prescaler 1) instead of 0.5 us per count, i.e. 2000 counts per
+ * period @ 16Mhz 8kHz
+ */
+//#define PWM_HIRES
+
 
 // 1/8000  = 0.000125 = 12.5 * 10^(-5)
 // 1/12000 = 0.000083 = 8.3 * 10^(-5)
@@ -158,13 +260,41 @@
 // @12k:
 //  0.000083 / 0.5 us  = 166.67 counts
 
+// PWM timer counts per us
+#if !defined( PWM_HIRES )
+  #define PWM_CNT_US     2
+#elif defined( CLOCK_16 )
+  #define PWM_CNT_US     16
+#else
+  #define PWM_CNT_US     8
+#endif
+
 #ifdef PWM_8K
-  #define TIM2_PWM_PD    250   // 125uS
+  #define TIM2_PWM_PD    ( (1000 * PWM_CNT_US) / 8 )   // 125uS (250 counts)
 #else // 12kHz
-  #define TIM2_PWM_PD    166   //  83uS
+  #define TIM2_PWM_PD    ( (1000 * PWM_CNT_US) / 12 )  //  83uS (166 counts)
 #endif
 
 #define PWM_100PCNT  TIM2_PWM_PD
 
+/*
+ * The duty-cycle command is 16-bit fixed-point, DC_SH fractional bits of a 0.4%
+ * step (1/250 i.e. 1 count of the 8kHz PWM at 0.5 us, which is also the index
+ * of the open-loop timing table). It does not depend on the PWM timebase and is
+ * only scaled to timer counts at the compare register, see set_dutycycle().
+ */
+#define DC_SH        8
+#define DC_100PCNT   ( (uint16_t)250 << DC_SH )  // 64000
+
+/*
+ * Supply voltage measurement (ADC counts) at nominal battery voltage, the
+ * reference of the Vbatt compensation
+ */
+#if defined ( S105_DEV )
+#define VBATT_NOMINAL  0x03F0    // TBD experimentally determined
+#else
+#define VBATT_NOMINAL  0x03C0    // TBD experimentally determined
+#endif
+
 
 #endif // SYSTEM_H
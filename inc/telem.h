@@ -0,0 +1,33 @@
+/**
+  ******************************************************************************
+  * @file telem.h
+  * @brief ESC serial telemetry
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  */
+#ifndef TELEM_H
+#define TELEM_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+
+
+/*
+ * defines
+ */
+
+// KISS ESC telemetry frame: temperature, voltage, current, consumption,
+// eRPM and CRC-8
+#define TELEM_FRAME_LEN  10
+
+
+/*
+ * prototypes
+ */
+
+void Telem_Task(void);
+
+
+#endif // TELEM_H
@@ -0,0 +1,35 @@
+/**
+  ******************************************************************************
+  * @file thr_curve.h
+  * @brief Throttle curve
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  */
+#ifndef THR_CURVE_H
+#define THR_CURVE_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+
+
+/*
+ * defines
+ */
+
+// knots evenly spaced over the throttle range [0:DC_100PCNT]
+#define THR_CURVE_KNOTS  9
+
+
+/*
+ * prototypes
+ */
+
+void Thr_curve_Init(void);
+uint16_t Thr_curve_Apply(uint16_t dc);
+uint8_t Thr_curve_Set(const uint16_t * p_knots);
+uint16_t Thr_curve_Get(uint8_t knot);
+
+
+#endif // THR_CURVE_H
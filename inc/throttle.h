@@ -0,0 +1,68 @@
+/**
+  ******************************************************************************
+  * @file throttle.h
+  * @brief Pulse-width throttle input protocols
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  */
+#ifndef THROTTLE_H
+#define THROTTLE_H
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+
+
+/*
+ * defines
+ */
+
+// normalized throttle is the duty-cycle command [0:DC_100PCNT] regardless of
+// protocol, see BLDC_PWMDC_Set
+#define THROTTLE_MAX  DC_100PCNT
+
+
+/*
+ * types
+ */
+
+/**
+ * @brief Pulse-width throttle protocols, in order of the pulse width range
+ */
+typedef enum
+{
+  THR_NONE,        // not (yet) detected
+  THR_SERVO,       // 1000-2000 us
+  THR_ONESHOT125,  // 125-250 us
+  THR_ONESHOT42,   // 42-84 us
+  THR_MULTISHOT,   // 5-25 us
+  THR_NR_PROTO
+} thr_proto_t;
+
+/**
+ * @brief Throttle signal state
+ */
+typedef enum
+{
+  THR_SIG_NONE,   // no signal since reset, the throttle is not used
+  THR_SIG_OK,     // enough consecutive good frames
+  THR_SIG_LOST    // signal was lost, failsafe is applied
+} thr_signal_t;
+
+
+/*
+ * prototypes
+ */
+
+void Throttle_Init(void);
+void Throttle_on_pulse(uint16_t perd, uint16_t dur);
+void Throttle_Update(void);
+uint8_t Throttle_Task(void);
+
+uint16_t Throttle_Get(void);
+thr_proto_t Throttle_Get_protocol(void);
+thr_signal_t Throttle_Get_signal(void);
+
+
+#endif // THROTTLE_H
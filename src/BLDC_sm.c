@@ -10,167 +10,1296 @@
 /**
  * \defgroup BLDC_sm BLDC State
  * @brief BLDC state management and timing control
+ *
+ * @details The motor operation cycle is a table-driven state machine, see
+ * @ref statem. Each state has entry/exit actions and an action run every
+ * control tick, and the transitions are guarded in a const table which is
+ * evaluated in order at the control rate (first matching guard wins). The
+ * number of control ticks spent in each state is kept (from the latest entry)
+ * to measure the startup phase durations.
  * @{
  */
 
 /* Includes ------------------------------------------------------------------*/
 #include <stddef.h>  // NULL
+#include "system.h"
 #include "bldc_sm.h" // external types used internally
 #include "mdata.h"
+#if !defined( UNIT_TEST )
 #include "pwm_stm8s.h" // motor phase control
+#else
+void All_phase_stop(void);
+void set_dutycycle(uint16_t);
+#endif
 #include "faultm.h"
 #include "sequence.h"
+#include "driver.h"
+#include "thr_curve.h"
+#include "pi_ctrl.h"
+
+/* Private defines -----------------------------------------------------------*/
+
+#define PWM_0PCNT      0
+
+// cast arg to 16-bit and group the pcnt*100 term to retain precision
+#define PWM_X_PCNT( _PCNT_ )   (uint16_t)( ( _PCNT_ * DC_100PCNT ) / 100.0 )
+
+/*
+ * duty-cycle command, see DC_100PCNT
+ */
+#define PWM_DC_RAMPUP    PWM_X_PCNT( 12.0 )  // 0x1E00 ... 30 * 0.4 = 12.0
+
+#define PWM_DC_SHUTOFF   PWM_X_PCNT( 8.0 )   // stalls below 18 counts (7.4 %)
+
+#define PWM_DC_CTRL_MODE  PWM_DC_RAMPUP
+
+
+/*
+ * These constants are the number of timer counts (TIM3) to achieve a given
+ *  commutation step period.
+ * See TIM3 setup - base period is 0.000000250 seconds (0.25 usec) in order to
+ * provide high precision for controlling the commutation time, and each commutation step
+ * unit is 4x TIM3 periods for back-EMF sampling at 1/4 and 3/4 in the commutation period.
+ *
+ * For the theoretical 1100kv motor @ 13.8v -> ~15000 RPM:
+ *   15000 / 60 = 250 rps
+ *   "Electrical cycles" per sec = 250 * (12/2) = 1500 ... where (12/2) is nr. of pole-pairs.
+ *   Time of 1 cycle = 1/1500 = 0.000667 seconds  (360 degrees of 1 electrical cycle)
+ *
+ *   1 commutation sector is 60 degrees.
+ *   Using TIM3 to get 4 updates per sector, and 360/15degrees=24 so ..
+ *
+ *   0.000667 seconds / 24 = 0.00002778 sec  (the "1/4 sector time" is 27.78us )
+ *   ... divided by TIM3 base period (0.25 us)  -> 111 counts
+ */
+
+//#define TIM3_RATE_MODULUS   4 // each commutation sector of 60-degrees spans 4x TIM3 periods
+// the commutation timing constants (TIM3 period) effectively have a factor of
+// 'TIM3_RATE_MODULUS' rolled into them since the timer fires 4x faster than the
+// actual motor commutation frequency.
+#define BLDC_OL_TM_LO_SPD     (0x0B00 * CTIME_SCALAR) // start of ramp
+
+//   0.000667 seconds / 24 / 0.25us = 111 counts
+#define LUDICROUS_SPEED       (0x006F * CTIME_SCALAR) // macro to determine this number from motor numbers?
+
+
+// ramp rate derived from control rate which is derived from overall system rate
+// commutation time factor is rolled in there as well
+#define BLDC_ONE_RAMP_UNIT    (1 * CTRL_RATEM * CTIME_SCALAR)
+
+/*
+ * Rotor alignment: one commutation step is energized with the duty-cycle
+ * ramped up to ALIGN_DC in ALIGN_RAMP_TICKS and held for the rest of
+ * ALIGN_TICKS (control ticks), the start ramp is then from the adjacent step.
+ * ALIGN_TICKS 0 to start without alignment.
+ */
+#if !defined( ALIGN_TICKS )
+#define ALIGN_TICKS           150
+#endif
+#if !defined( ALIGN_RAMP_TICKS )
+#define ALIGN_RAMP_TICKS      50
+#endif
+#if !defined( ALIGN_DC )
+#define ALIGN_DC              PWM_X_PCNT( 8.0 )
+#endif
+
+#define ALIGN_DC_STEP         ( ALIGN_DC / ALIGN_RAMP_TICKS )
+
+/*
+ * Catching a spinning rotor: with the bridge off, the back-EMF of phase A is
+ * sensed for up to CATCH_TICKS (control ticks), or CATCH_STILL_TICKS if no
+ * back-EMF is seen at all, before falling back to the alignment and start
+ * ramp. The rising zero-crossing of phase A is mid-sector of commutation
+ * step 5, i.e. 1/4 sector CATCH_ZC_QSECT of the 24 in the electrical cycle
+ * (the zero-crossing is sensed where the phase voltage crosses the middle of
+ * its envelope, so this may need trimming if the swing is not symmetric).
+ */
+#if !defined( CATCH_TICKS )
+#define CATCH_TICKS           100
+#endif
+#if !defined( CATCH_STILL_TICKS )
+#define CATCH_STILL_TICKS     40
+#endif
+#if !defined( CATCH_ZC_QSECT )
+#define CATCH_ZC_QSECT        ( (5 * 4) + 2 )
+#endif
+
+#define CATCH_QSECTS          24 // 1/4 sectors per electrical cycle
+
+
+/*
+ * Start ramp: the commutation frequency (not the period) is advanced along
+ * the acceleration profile, in units of RAMP_RECIP_NUM / period so that the
+ * period is the same reciprocal of the frequency. Acceleration is per control
+ * tick with RAMP_F_SH fractional bits. With a jerk limit the profile is an
+ * S-curve, and with RAMP_JERK 0 the acceleration is constant.
+ */
+#define RAMP_RECIP_NUM        ( 1UL << 22 )
+#define RAMP_F_SH             8
+
+#if !defined( RAMP_ACCEL )
+#define RAMP_ACCEL            ( 6 << RAMP_F_SH )
+#endif
+#if !defined( RAMP_JERK )
+#define RAMP_JERK             ( RAMP_ACCEL / 64 ) // full acceleration in 64 ticks
+#endif
+
+// reciprocal table, 2^30 / m over the normalized range m [0x8000:0x10000]
+#define RECIP_TB_SH           6   // 64 segments
+#define RECIP_FRAC_SH         ( 15 - RECIP_TB_SH )
+
+/*
+ * Slew-rate limit of the commanded duty-cycle, per control tick (~1 ms):
+ * defaults are 0-100% in ~0.5 s accelerating and ~0.25 s decelerating.
+ */
+#if !defined( DC_SLEW_ACCEL )
+#define DC_SLEW_ACCEL         ( (1 << DC_SH) / 2 )
+#endif
+#if !defined( DC_SLEW_DECEL )
+#define DC_SLEW_DECEL         ( (1 << DC_SH) / 1 )
+#endif
+
+// in open-loop the duty-cycle slew holds while the commutation timing ramp
+// lags the table timing of the present duty-cycle by more than this
+#define DC_SLEW_SYNC_TOL      ( 8 * BLDC_ONE_RAMP_UNIT )
+
+
+/*
+ * Closed-loop commutation timing: the PI controller output is a correction of
+ * the open-loop table timing in 1/1024 of the table timing, limited to +/-1/4.
+ * The commutation period is then moved toward the corrected timing by at most
+ * one ramp unit per control tick (timing_ramp_control).
+ */
+#define TMCTRL_CORR_SH        10
+#define TMCTRL_CORR_MAX       ( (1 << TMCTRL_CORR_SH) / 4 )
+
+#if !defined( TMCTRL_KP )
+#define TMCTRL_KP             ( (1 << PI_GAIN_SH) * 2 )
+#endif
+#if !defined( TMCTRL_KI )
+#define TMCTRL_KI             ( (1 << PI_GAIN_SH) / 2 )
+#endif
+
+// the timing error (back-EMF ratio, 64 == 1.0) is plausible within +/-0.5
+#define TMCTRL_ERR_PLAUS      32
+
+// control ticks of (im)plausible timing error to switch to closed loop or
+// fall back to open-loop
+#define TMCTRL_DEBOUNCE       8
+
+
+/*
+ * RPM governor: the speed input [0:DC_100PCNT] is the target speed up to
+ * GOV_ERPM100_MAX (eRPM/100). The duty-cycle is the open-loop table
+ * duty-cycle of the target (feed-forward) plus the PI controller correction,
+ * limited to +/-1/4 of full scale.
+ */
+#if !defined( GOV_ERPM100_MAX )
+#define GOV_ERPM100_MAX       900   // 90000 eRPM e.g. 15000 RPM, 6 pole-pairs
+#endif
+
+#define GOV_CORR_MAX          ( DC_100PCNT / 4 )
+
+// gains: duty-cycle command per eRPM/100 of error
+#if !defined( GOV_KP )
+#define GOV_KP                ( (1 << PI_GAIN_SH) * 16 )
+#endif
+#if !defined( GOV_KI )
+#define GOV_KI                ( (1 << PI_GAIN_SH) * 1 )
+#endif
+
+
+/*
+ * Open-loop timing table tuning: the duty-cycle is stepped through the knots
+ * of the table (see mdata.h) in closed-loop, and at each knot the commutation
+ * period is averaged over 2^OL_TUNE_AVG_SH control ticks once settled for
+ * OL_TUNE_SETTLE_TICKS. The sweep fails if a knot is not reached in
+ * closed-loop within OL_TUNE_TMO_TICKS.
+ */
+#if !defined( OL_TUNE_SETTLE_TICKS )
+#define OL_TUNE_SETTLE_TICKS  500
+#endif
+
+#define OL_TUNE_AVG_SH        6
+
+#if !defined( OL_TUNE_TMO_TICKS )
+#define OL_TUNE_TMO_TICKS     3000
+#endif
+
+
+/*
+ * Battery voltage compensation of the commanded duty-cycle.
+ * The nominal value (VBATT_NOMINAL) is the Vbatt measurement (raw ADC counts) at which the
+ * open-loop timing table was characterized, i.e. the bench supply.
+ * The scale factor Vnominal/Vbatt is unsigned fixed-point with 8 fractional
+ * bits and is clipped to a plausible range so that a bad measurement can't
+ * command anything drastic.
+ */
+#define VBATT_COMP_SH         8
+#define VBATT_COMP_ONE        (1 << VBATT_COMP_SH)
+#define VBATT_COMP_MIN        (VBATT_COMP_ONE - (VBATT_COMP_ONE >> 2))  // 0.75
+#define VBATT_COMP_MAX        (VBATT_COMP_ONE + (VBATT_COMP_ONE >> 1))  // 1.50
+
+// below this the measurement is not plausible (not running or not yet settled)
+#define VBATT_COMP_PLAUS_THR  (VBATT_NOMINAL / 2)
+
+// the filter and scale factor are updated at a sub-rate of the control task
+#define VBATT_COMP_RATEM      8
+
+// Vbatt filter time constant, 2^3 updates (~64 control ticks) - follows the
+// sag under load but not the PWM ripple of a single measurement
+#define VBATT_FILT_SH         3
+
+/*
+ * Average current limit: the duty-cycle ceiling is backed off by this much
+ * per control tick while the average current is over the limit, and is
+ * released at half that rate.
+ */
+#define ISENSE_DC_BACKOFF     ( 2 << DC_SH )
+#define ISENSE_DC_RELEASE     ( 1 << DC_SH )
+
+// 10A average current limit (ADC counts above zero-current, ~20.5 counts/A)
+#define ISENSE_LIMIT          0x00CD
+
+
+/* Private types -----------------------------------------------------------*/
+
+/**
+ * @brief State actions (NULL if none).
+ */
+typedef struct
+{
+  void (*entry)(void);   /**< On entering the state */
+  void (*action)(void);  /**< Every control tick while in the state */
+  void (*exit)(void);    /**< On leaving the state */
+} bl_state_actions_t;
+
+/**
+ * @brief Guarded state transition.
+ */
+typedef struct
+{
+  BL_STATE_t from;
+  uint8_t (*guard)(void);
+  BL_STATE_t to;
+} bl_transition_t;
+
+/* Public variables  ---------------------------------------------------------*/
+
+/* Private variables ---------------------------------------------------------*/
+
+static uint16_t BLDC_OL_comm_tm;     // persistent value of ramp timing
+
+static uint16_t Commanded_Dutycycle; // copied select DC to global for logging
+
+static uint16_t UI_speed;            // input from UI task, file-scope for sm_update
+
+static uint8_t Input_on;             // speed input is above the shutoff
+
+static uint8_t Rearm_req;            // speed input dropped to the shutoff in FAULT
+
+static uint16_t Slew_dc;             // slew limited duty-cycle
+
+static uint16_t Align_dc;            // alignment duty-cycle
+
+static uint32_t Ramp_freq;           // start ramp frequency, RAMP_F_SH fraction
+
+static uint16_t Ramp_accel;          // start ramp acceleration per tick
+
+#if defined( CATCH_ENABLED )
+static uint8_t Catch_synced;         // commutation is synchronized to the rotor
+#endif
+
+static uint8_t Control_mode;   // indicates manual commuation buttons are active
+
+static pi_ctrl_t Timing_pi;          // closed-loop commutation timing
+
+static uint8_t Timing_plaus_count;   // debounce of the timing error plausibility
+
+#if defined( GOVERNOR_ENABLED )
+static pi_ctrl_t Gov_pi;             // RPM governor
+
+static uint16_t Gov_cmd;             // speed input of the present target
+
+static uint16_t Gov_tgt;             // target eRPM/100
+
+static uint16_t Gov_ff_dc;           // feed-forward duty-cycle of the target
+#endif
+
+#if defined( OL_TUNE_ENABLED )
+static BL_TUNE_t Tune_state;
+
+static uint16_t Tune_knots[ OL_TUNE_KNOTS ]; // measured commutation periods
+
+static uint8_t Tune_knot;            // present knot of the sweep
+
+static uint16_t Tune_ticks;          // control ticks at the knot in closed-loop
+
+static uint16_t Tune_tmo;            // control ticks since the knot started
+
+static uint32_t Tune_sum;            // sum of the commutation period
+#endif
+
+static BL_STATE_t BL_state;          // state machine
+static uint16_t BL_state_ticks[ BL_ST_COUNT ]; // control ticks in state
+
+#ifdef VBATT_COMP_ENABLED
+static uint16_t Vbatt_accum;         // filtered Vbatt, scaled by 2^VBATT_FILT_SH
+
+static uint16_t Vbatt_comp_scale;    // Vnominal/Vbatt, fixed-point VBATT_COMP_SH
+#endif
+
+#if defined( CURRENT_SENSE_ENABLED )
+static uint16_t Isense_dc_limit;     // duty-cycle ceiling of current limit loop
+#endif
+
+
+/* Private function prototypes -----------------------------------------------*/
+
+static void st_reset_entry(void);
+static void st_ready_entry(void);
+static void st_ramp_entry(void);
+#if defined( CATCH_ENABLED )
+static void st_catch_entry(void);
+static void st_catch_exit(void);
+static void st_catch(void);
+#endif
+static void st_idle(void);
+static void st_align(void);
+static void st_ramp(void);
+static void st_run(void);
+static void st_fault(void);
+
+static uint8_t g_true(void);
+static uint8_t g_fault(void);
+static uint8_t g_speed(void);
+static uint8_t g_stopped(void);
+static uint8_t g_aligned(void);
+static uint8_t g_ramp_done(void);
+static uint8_t g_rearm(void);
+#if defined( CATCH_ENABLED )
+static uint8_t g_caught(void);
+static uint8_t g_catch_tmo(void);
+#endif
+
+
+/* Private constants ---------------------------------------------------------*/
+
+static const uint16_t Recip_tb[ (1 << RECIP_TB_SH) + 1 ] =
+{
+  32768, 32264, 31775, 31301, 30840, 30394, 29959, 29537,
+  29127, 28728, 28340, 27962, 27594, 27236, 26887, 26546,
+  26214, 25891, 25575, 25267, 24966, 24672, 24385, 24105,
+  23831, 23564, 23302, 23046, 22795, 22550, 22310, 22075,
+  21845, 21620, 21400, 21183, 20972, 20764, 20560, 20361,
+  20165, 19973, 19784, 19600, 19418, 19240, 19065, 18893,
+  18725, 18559, 18396, 18236, 18079, 17924, 17772, 17623,
+  17476, 17332, 17190, 17050, 16913, 16777, 16644, 16513,
+  16384
+};
+
+// indexed by BL_STATE_t
+static const bl_state_actions_t BL_state_tb[ BL_ST_COUNT ] =
+{
+  /* BL_ST_RESET */ { st_reset_entry, st_idle,   NULL },
+  /* BL_ST_READY */ { st_ready_entry, st_idle,   NULL },
+#if defined( CATCH_ENABLED )
+  /* BL_ST_CATCH */ { st_catch_entry, st_catch,  st_catch_exit },
+#else
+  /* BL_ST_CATCH */ { NULL,           st_idle,   NULL }, // not reachable
+#endif
+  /* BL_ST_ALIGN */ { NULL,           st_align,  NULL },
+  /* BL_ST_RAMP  */ { st_ramp_entry,  st_ramp,   NULL },
+  /* BL_ST_RUN   */ { NULL,           st_run,    NULL },
+  /* BL_ST_FAULT */ { st_fault,       st_fault,  NULL },
+};
+
+// evaluated in order, the first transition with a true guard is taken
+static const bl_transition_t BL_transition_tb[] =
+{
+  { BL_ST_RESET, g_true,      BL_ST_READY },
+  { BL_ST_READY, g_fault,     BL_ST_FAULT },
+#if defined( CATCH_ENABLED )
+  { BL_ST_READY, g_speed,     BL_ST_CATCH },
+  { BL_ST_CATCH, g_fault,     BL_ST_FAULT },
+  { BL_ST_CATCH, g_stopped,   BL_ST_READY },
+  { BL_ST_CATCH, g_caught,    BL_ST_RUN   },
+  { BL_ST_CATCH, g_catch_tmo, BL_ST_ALIGN },
+#else
+  { BL_ST_READY, g_speed,     BL_ST_ALIGN },
+#endif
+  { BL_ST_ALIGN, g_fault,     BL_ST_FAULT },
+  { BL_ST_ALIGN, g_stopped,   BL_ST_READY },
+  { BL_ST_ALIGN, g_aligned,   BL_ST_RAMP  },
+  { BL_ST_RAMP,  g_fault,     BL_ST_FAULT },
+  { BL_ST_RAMP,  g_stopped,   BL_ST_READY },
+  { BL_ST_RAMP,  g_ramp_done, BL_ST_RUN   },
+  { BL_ST_RUN,   g_fault,     BL_ST_FAULT },
+  { BL_ST_RUN,   g_stopped,   BL_ST_READY },
+  { BL_ST_FAULT, g_rearm,     BL_ST_RESET },
+};
+
+#define _SIZE_TRANS_TB  ( sizeof( BL_transition_tb ) / sizeof( bl_transition_t ) )
+
+
+/* Private functions ---------------------------------------------------------*/
+
+/**
+ * @brief  Commutation timing ramp control.
+ *
+ * At each iteration the commutation time period is ramped to the target value
+ * stepped in increment of +/- step depending on the sign of the error. The
+ * target is limited to LUDICROUS_SPEED in either mode, the upper end of the
+ * open-loop table being faster than that.
+ *
+ * @param   tgt_commutation_per  Target value to track.
+ */
+static void timing_ramp_control(uint16_t tgt_commutation_per)
+{
+  const uint8_t stepi = BLDC_ONE_RAMP_UNIT;
+
+  uint16_t u16 = BLDC_OL_comm_tm;
+
+  if (tgt_commutation_per < LUDICROUS_SPEED)
+  {
+    tgt_commutation_per = LUDICROUS_SPEED;
+  }
+
+  // determine signage of error i.e. step increment
+  if (u16 > tgt_commutation_per)
+  {
+    u16 -= stepi;
+    if (u16 < tgt_commutation_per)
+    {
+      u16 = tgt_commutation_per;
+    }
+    BLDC_OL_comm_tm  = u16;
+  }
+  else if (u16 < tgt_commutation_per)
+  {
+    u16 += stepi;
+    if (u16 > tgt_commutation_per)
+    {
+      u16 = tgt_commutation_per;
+    }
+    BLDC_OL_comm_tm  = u16;
+  }
+}
+
+#ifdef CLMODE_ENABLED
+/**
+ * @brief  Closed-loop control mode switching.
+ *
+ * @details The timing error is used if the back-EMF amplitude is plausible and
+ * the error is within range. The mode is switched after the condition has
+ * persisted, with the controller preset to the present timing (bumpless). In
+ * open-loop the period is ramped back to the table timing.
+ */
+static void timing_mode_update(void)
+{
+  int16_t err = Seq_get_timing_error();
+  uint8_t plaus =
+    (uint8_t)( 0 == Seq_get_timing_error_p()  &&
+               err < TMCTRL_ERR_PLAUS  &&  err > -TMCTRL_ERR_PLAUS );
+
+  if (plaus == Control_mode)
+  {
+    Timing_plaus_count = 0;
+  }
+  else if (++Timing_plaus_count >= TMCTRL_DEBOUNCE)
+  {
+    Timing_plaus_count = 0;
+    Control_mode = plaus;
+
+    if (FALSE != Control_mode)
+    {
+      uint16_t ol_tm = Get_OL_Timing(Commanded_Dutycycle);
+
+      PI_ctrl_Reset( &Timing_pi,
+                     (int16_t)( ( ((int32_t)BLDC_OL_comm_tm - ol_tm) << TMCTRL_CORR_SH ) /
+                                ol_tm ) );
+    }
+  }
+}
+#endif // CLMODE_ENABLED
+
+/**
+ * @brief  Closed-loop commutation timing control.
+ *
+ * @details If the motor timing is advanced the error is positive i.e. the
+ *  period is increased.
+ *
+ * @param   ol_tm  Open-loop table timing of the duty-cycle.
+ *
+ * @return  Target commutation period.
+ */
+static uint16_t timing_control(uint16_t ol_tm)
+{
+  int16_t corr = PI_ctrl_Update( &Timing_pi, Seq_get_timing_error() );
+
+  return ol_tm + (int16_t)( ( (int32_t)ol_tm * corr ) >> TMCTRL_CORR_SH );
+}
+
+#if defined( GOVERNOR_ENABLED )
+/**
+ * @brief  RPM governor.
+ *
+ * @details The commutation period is a measurement of the speed only in
+ *  closed-loop, so in open-loop (start ramp or fallback) the feed-forward
+ *  duty-cycle is applied and the controller is preset to the present
+ *  duty-cycle (bumpless). The feed-forward is a table search, so it is only
+ *  done when the target changes.
+ *
+ * @param   cmd  Speed input.
+ *
+ * @return  Duty-cycle command.
+ */
+static uint16_t governor(uint16_t cmd)
+{
+  int32_t dc;
+
+  if (cmd != Gov_cmd)
+  {
+    Gov_cmd = cmd;
+    Gov_tgt = (uint16_t)( ( (uint32_t)cmd * GOV_ERPM100_MAX ) / DC_100PCNT );
+
+    Gov_ff_dc = (0 != Gov_tgt) ?
+                Get_OL_Dutycycle( (uint16_t)( COMM_ERPM100_NUM / Gov_tgt ) ) : PWM_0PCNT;
+  }
+
+  if (FALSE == Control_mode)
+  {
+    dc = (int32_t)Slew_dc - Gov_ff_dc;
+
+    if (dc > GOV_CORR_MAX)
+    {
+      dc = GOV_CORR_MAX;
+    }
+    else if (dc < -GOV_CORR_MAX)
+    {
+      dc = -GOV_CORR_MAX;
+    }
+    PI_ctrl_Reset( &Gov_pi, (int16_t)dc );
+
+    return Gov_ff_dc;
+  }
+
+  dc = (int32_t)Gov_ff_dc +
+       PI_ctrl_Update( &Gov_pi,
+                       (int16_t)( Gov_tgt - (uint16_t)( COMM_ERPM100_NUM / BLDC_OL_comm_tm ) ) );
+
+  // not below the shutoff i.e. the governor does not stall the motor
+  if (dc < PWM_DC_SHUTOFF)
+  {
+    dc = PWM_DC_SHUTOFF;
+  }
+  else if (dc > DC_100PCNT)
+  {
+    dc = DC_100PCNT;
+  }
+  return (uint16_t)dc;
+}
+#endif // GOVERNOR_ENABLED
+
+/**
+ * @brief  Reciprocal RAMP_RECIP_NUM / x.
+ *
+ * @details Table lookup on the normalized argument, linear interpolation
+ *  between the table entries (~1e-4 relative error before the truncation of
+ *  the result), no division.
+ *
+ * @param   x  Argument.
+ *
+ * @return  Reciprocal, U16_MAX if out of range.
+ */
+static uint16_t recip(uint16_t x)
+{
+  uint32_t u32;
+  uint16_t t0;
+  uint16_t frac;
+  uint8_t index;
+  uint8_t sh = 0;
+
+  if (0 == x)
+  {
+    return U16_MAX;
+  }
+
+  while (0 == (x & 0x8000))
+  {
+    x <<= 1;
+    sh += 1;
+  }
+
+  index = (uint8_t)( (x >> RECIP_FRAC_SH) & ((1 << RECIP_TB_SH) - 1) );
+  frac = x & ( (1 << RECIP_FRAC_SH) - 1 );
+
+  t0 = Recip_tb[ index ];
+  t0 -= (uint16_t)( ( (uint32_t)(t0 - Recip_tb[ index + 1 ]) * frac ) >> RECIP_FRAC_SH );
+
+  // 2^22 / x = (2^30 / (x << sh)) * 2^sh / 2^8
+  u32 = ( (uint32_t)t0 << sh ) >> 8;
+
+  return (u32 > U16_MAX) ? U16_MAX : (uint16_t)u32;
+}
+
+/**
+ * @brief  Start ramp control.
+ *
+ * @details The commutation frequency is advanced toward the target at the
+ *  profile acceleration, and the commutation period is the reciprocal. With
+ *  the S-curve, the acceleration is increased at the jerk limit and backed off
+ *  ahead of the target so that it is reached with little acceleration left
+ *  i.e. when the remaining frequency is a^2 / 2j. A lower target (throttle
+ *  drop) is followed at the acceleration limit.
+ *
+ * @param   tgt_commutation_per  Target value to track.
+ */
+static void freq_ramp_control(uint16_t tgt_commutation_per)
+{
+  uint32_t tgt = (uint32_t)recip(tgt_commutation_per) << RAMP_F_SH;
+  uint32_t freq = Ramp_freq;
+  uint16_t accel = Ramp_accel;
+
+  if (freq < tgt)
+  {
+#if RAMP_JERK > 0
+    if ( (tgt - freq) * (2 * RAMP_JERK) <= (uint32_t)accel * accel )
+    {
+      accel = (accel > (2 * RAMP_JERK)) ? (accel - RAMP_JERK) : RAMP_JERK;
+    }
+    else if (accel < RAMP_ACCEL)
+    {
+      accel = ( (RAMP_ACCEL - accel) > RAMP_JERK ) ? (accel + RAMP_JERK) : RAMP_ACCEL;
+    }
+#endif
+    freq += accel;
+    if (freq > tgt)
+    {
+      freq = tgt;
+    }
+  }
+  else if (freq > tgt)
+  {
+    freq = ( (freq - tgt) > RAMP_ACCEL ) ? (freq - RAMP_ACCEL) : tgt;
+  }
+
+  Ramp_freq = freq;
+  Ramp_accel = accel;
+
+  BLDC_OL_comm_tm = recip( (uint16_t)(freq >> RAMP_F_SH) );
+}
+
+/**
+ * @brief  Open-loop timing is in sync with the table.
+ *
+ * @param   dc  Duty-cycle.
+ *
+ * @return  TRUE if the commutation period is within the tolerance of the table
+ *          timing of the duty-cycle.
+ */
+static uint8_t ol_timing_synced(uint16_t dc)
+{
+  uint16_t ol_tm = Get_OL_Timing(dc);
+
+  if ( BLDC_OL_comm_tm > (ol_tm + DC_SLEW_SYNC_TOL)  ||
+       (BLDC_OL_comm_tm + DC_SLEW_SYNC_TOL) < ol_tm )
+  {
+    return FALSE;
+  }
+  return TRUE;
+}
+
+/**
+ * @brief  Duty-cycle slew-rate limit.
+ *
+ * @details Separate acceleration and deceleration limits. In open-loop the
+ * commutation period is ramped toward the table timing of the duty-cycle at
+ * a fixed rate, so an increase is held while the timing has not caught up,
+ * i.e. the table is steep at low speed and a throttle punch would otherwise
+ * run the duty-cycle ahead of the timing and desync. A decrease is never held. The start duty-cycle is
+ * applied without limit as the start ramp has its own timing.
+ *
+ * @param   dc  Commanded duty-cycle.
+ *
+ * @return  Slew limited duty-cycle.
+ */
+static uint16_t dc_slew(uint16_t dc)
+{
+  uint16_t u16 = Slew_dc;
+
+  if (u16 < PWM_DC_RAMPUP)
+  {
+    u16 = (dc < PWM_DC_RAMPUP) ? dc : PWM_DC_RAMPUP;
+  }
+  else if (dc > u16)
+  {
+    // the ramp tracks the table timing of the applied duty-cycle (following
+    // compensation and limit) so the sync is to that, not the slew value
+    if ( FALSE != Control_mode  ||
+         FALSE != ol_timing_synced(Commanded_Dutycycle) )
+    {
+      u16 = ( (dc - u16) > DC_SLEW_ACCEL ) ? (u16 + DC_SLEW_ACCEL) : dc;
+    }
+  }
+  else if (dc < u16)
+  {
+    u16 = ( (u16 - dc) > DC_SLEW_DECEL ) ? (u16 - DC_SLEW_DECEL) : dc;
+  }
+
+  Slew_dc = u16;
+
+  return u16;
+}
+
+#ifdef VBATT_COMP_ENABLED
+/**
+ * @brief  Update the battery voltage compensation scale factor.
+ *
+ * @details The Vbatt measurement is filtered (exponential moving average,
+ * alpha = 1/2^VBATT_FILT_SH) and the scale factor
+ * Vnominal/Vbatt is recomputed - called at a sub-rate of the control task as
+ * the battery voltage can only change slowly, so the division isn't done
+ * every control tick.
+ */
+static void vbatt_comp_update(void)
+{
+  uint16_t vbatt = Seq_Get_Vbatt();
+  uint16_t u16;
+
+  // seed the filter from the first measurement
+  if (0 == Vbatt_accum)
+  {
+    Vbatt_accum = vbatt << VBATT_FILT_SH;
+  }
+  Vbatt_accum = Vbatt_accum - (Vbatt_accum >> VBATT_FILT_SH) + vbatt;
+  vbatt = Vbatt_accum >> VBATT_FILT_SH;
+
+  u16 = VBATT_COMP_ONE; // unity gain if the measurement is not plausible
+
+  if (vbatt > VBATT_COMP_PLAUS_THR)
+  {
+    u16 = (uint16_t)( ( (uint32_t)VBATT_NOMINAL << VBATT_COMP_SH ) / vbatt );
+
+    if (u16 < VBATT_COMP_MIN)
+    {
+      u16 = VBATT_COMP_MIN;
+    }
+    else if (u16 > VBATT_COMP_MAX)
+    {
+      u16 = VBATT_COMP_MAX;
+    }
+  }
+  Vbatt_comp_scale = u16;
+}
+
+/**
+ * @brief  Apply battery voltage compensation to the commanded duty-cycle.
+ *
+ * @param   dc  Commanded duty-cycle.
+ *
+ * @return  Duty-cycle scaled by Vnominal/Vbatt, clipped to 100%.
+ */
+static uint16_t vbatt_comp(uint16_t dc)
+{
+  uint16_t u16 = (uint16_t)( ( (uint32_t)dc * Vbatt_comp_scale ) >> VBATT_COMP_SH );
+
+  if (u16 > DC_100PCNT)
+  {
+    u16 = DC_100PCNT;
+  }
+  return u16;
+}
+#endif // VBATT_COMP_ENABLED
+
+#if defined( CURRENT_SENSE_ENABLED )
+/**
+ * @brief  Average current limit.
+ *
+ * @details Integrating control of a duty-cycle ceiling: while the average
+ * current is above the limit, the ceiling is pulled down from the present
+ * duty-cycle, and otherwise it is slowly released. The ceiling is not allowed
+ * below the shutoff threshold, i.e. the limit loop does not stop the motor
+ * (peak current is cut cycle-by-cycle in hardware anyway).
+ *
+ * @param   dc  Commanded duty-cycle.
+ *
+ * @return  Duty-cycle limited to the present ceiling.
+ */
+static uint16_t current_limit(uint16_t dc)
+{
+  uint16_t u16 = Isense_dc_limit;
+
+  if ( Driver_Get_Current() > ISENSE_LIMIT )
+  {
+    // start from the present duty-cycle so the limit acts immediately
+    if (u16 > dc)
+    {
+      u16 = dc;
+    }
+    if (u16 > (PWM_DC_SHUTOFF + ISENSE_DC_BACKOFF) )
+    {
+      u16 -= ISENSE_DC_BACKOFF;
+    }
+  }
+  else if (u16 < DC_100PCNT)
+  {
+    u16 = ( (DC_100PCNT - u16) > ISENSE_DC_RELEASE ) ?
+          (u16 + ISENSE_DC_RELEASE) : DC_100PCNT;
+  }
+  Isense_dc_limit = u16;
+
+  if (dc > u16)
+  {
+    dc = u16;
+  }
+  return dc;
+}
+#endif // CURRENT_SENSE_ENABLED
+
+#if defined( OL_TUNE_ENABLED )
+/*
+ * Start the sweep at a knot
+ */
+static void tune_knot_start(uint8_t knot)
+{
+  Tune_knot = knot;
+  Tune_ticks = 0;
+  Tune_tmo = 0;
+  Tune_sum = 0;
+}
+
+/*
+ * Tuning sweep, in RUN after the timing update. At the end of the sweep the
+ * tuned table applies and the timing control is handed back to open-loop,
+ * which now tracks the motor; the handover to closed-loop follows with both
+ * PI controllers preset at the present operating point.
+ */
+static void tune_update(void)
+{
+  if ( Slew_dc != OL_TUNE_DC(Tune_knot)  ||  FALSE == Control_mode )
+  {
+    Tune_ticks = 0;
+    Tune_sum = 0;
+
+    if (++Tune_tmo >= OL_TUNE_TMO_TICKS)
+    {
+      Tune_state = BL_TUNE_FAIL;
+    }
+    return;
+  }
+
+  Tune_ticks += 1;
+
+  if (Tune_ticks > OL_TUNE_SETTLE_TICKS)
+  {
+    Tune_sum += BLDC_OL_comm_tm;
+
+    if ( Tune_ticks >= (OL_TUNE_SETTLE_TICKS + (1 << OL_TUNE_AVG_SH)) )
+    {
+      Tune_knots[ Tune_knot ] = (uint16_t)( Tune_sum >> OL_TUNE_AVG_SH );
+
+      if (Tune_knot < (OL_TUNE_KNOTS - 1))
+      {
+        tune_knot_start(Tune_knot + 1);
+      }
+      else
+      {
+        Tune_state = (FALSE != Mdata_Set(Tune_knots)) ? BL_TUNE_DONE : BL_TUNE_FAIL;
+
+        Control_mode = FALSE;
+        Timing_plaus_count = 0;
+#if defined( GOVERNOR_ENABLED )
+        Gov_cmd = 0; // feed-forward of the tuned table
+#endif
+      }
+    }
+  }
+}
+#endif // OL_TUNE_ENABLED
+
+/*
+ * BL_stop
+ * common sub for stopping and fault states
+ */
+static void haltensie(void)
+{
+// have to clear the local UI_speed since that is the transition OFF->RAMP condition
+  UI_speed = 0;
+  Slew_dc = 0;
+
+  // kill the driver signals
+  All_phase_stop();
+}
+
+/*
+ * Take the transition to the new state: exit and entry actions, and the time
+ * in the new state starts over.
+ */
+static void set_state(BL_STATE_t state)
+{
+  if (NULL != BL_state_tb[ BL_state ].exit)
+  {
+    BL_state_tb[ BL_state ].exit();
+  }
+
+  BL_state = state;
+  BL_state_ticks[ state ] = 0;
+
+  if (NULL != BL_state_tb[ state ].entry)
+  {
+    BL_state_tb[ state ].entry();
+  }
+}
+
+/*
+ * RESET entry: re-initialize and clear faults
+ */
+static void st_reset_entry(void)
+{
+  // stop the system in case it is already running
+  haltensie();  //  zeros the  UI speed
+
+  Faultm_init();
+
+  Rearm_req = FALSE;
+
+#ifdef VBATT_COMP_ENABLED
+  // Vbatt is not measured while stopped, start over from unity gain
+  Vbatt_accum = 0;
+  Vbatt_comp_scale = VBATT_COMP_ONE;
+#endif
+
+#if defined( CURRENT_SENSE_ENABLED )
+  Isense_dc_limit = DC_100PCNT;
+#endif
+}
+
+/*
+ * READY entry: bridge off, initial conditions of the start ramp (also entered
+ * if the motor is stopped without fault, see BL_stop)
+ */
+static void st_ready_entry(void)
+{
+#if defined( OL_TUNE_ENABLED )
+  if (BL_TUNE_SWEEP == Tune_state)
+  {
+    Tune_state = BL_TUNE_FAIL; // stopped
+  }
+#endif
+  Timing_plaus_count = 0;
+  Slew_dc = 0;
+  Align_dc = 0;
+#if defined( GOVERNOR_ENABLED )
+  Gov_cmd = 0; // the target is recomputed at start
+#endif
+  All_phase_stop();
 
-/* Private defines -----------------------------------------------------------*/
+  // the commutation period (TIM3) apparantly has to be set to something (not 0)
+  // If TIM3 IE, the period must be long enough to ensure not saturated by ISR!
 
-#define PWM_0PCNT      0
+  // Set initial commutation timing period upon state transition.
+  BLDC_OL_comm_tm = BLDC_OL_TM_LO_SPD;
 
-// cast arg to 16-bit and group the pcnt*100 term to retain precision
-#define PWM_X_PCNT( _PCNT_ )   (uint16_t)( ( _PCNT_ * PWM_100PCNT ) / 100.0 )
+  Control_mode = FALSE;
+}
 
 /*
- * precision is 1/TIM2_PWM_PD = 0.4% per count
+ * Not driving the motor
  */
-#define PWM_DC_RAMPUP    PWM_X_PCNT( 12.0 )  // 0x1E ... 30 * 0.4 = 12.0
+static void st_idle(void)
+{
+  set_dutycycle(PWM_0PCNT);
+  Commanded_Dutycycle = PWM_0PCNT;
+}
 
-#define PWM_DC_SHUTOFF   PWM_X_PCNT( 8.0 )   // stalls below 18 counts (7.4 %)
+/*
+ * ALIGN: the alignment step is energized by the sequencer, see Sequence_Step
+ */
+static void st_align(void)
+{
+  uint16_t u16 = Align_dc;
 
-#define PWM_DC_CTRL_MODE  PWM_DC_RAMPUP
+  u16 = ( (ALIGN_DC - u16) > ALIGN_DC_STEP ) ? (u16 + ALIGN_DC_STEP) : ALIGN_DC;
+  Align_dc = u16;
+
+#if defined( CURRENT_SENSE_ENABLED )
+  u16 = current_limit(u16);
+#endif
 
+  set_dutycycle(u16);
+  Commanded_Dutycycle = u16;
+}
 
 /*
- * These constants are the number of timer counts (TIM3) to achieve a given
- *  commutation step period.
- * See TIM3 setup - base period is 0.000000250 seconds (0.25 usec) in order to
- * provide high precision for controlling the commutation time, and each commutation step
- * unit is 4x TIM3 periods for back-EMF sampling at 1/4 and 3/4 in the commutation period.
- *
- * For the theoretical 1100kv motor @ 13.8v -> ~15000 RPM:
- *   15000 / 60 = 250 rps
- *   "Electrical cycles" per sec = 250 * (12/2) = 1500 ... where (12/2) is nr. of pole-pairs.
- *   Time of 1 cycle = 1/1500 = 0.000667 seconds  (360 degrees of 1 electrical cycle)
- *
- *   1 commutation sector is 60 degrees.
- *   Using TIM3 to get 4 updates per sector, and 360/15degrees=24 so ..
- *
- *   0.000667 seconds / 24 = 0.00002778 sec  (the "1/4 sector time" is 27.78us )
- *   ... divided by TIM3 base period (0.25 us)  -> 111 counts
+ * RAMP entry: the start ramp is from the present period at rest
  */
+static void st_ramp_entry(void)
+{
+  Ramp_freq = (uint32_t)recip(BLDC_OL_comm_tm) << RAMP_F_SH;
+  Ramp_accel = (RAMP_JERK > 0) ? 0 : RAMP_ACCEL;
+}
 
-//#define TIM3_RATE_MODULUS   4 // each commutation sector of 60-degrees spans 4x TIM3 periods
-// the commutation timing constants (TIM3 period) effectively have a factor of
-// 'TIM3_RATE_MODULUS' rolled into them since the timer fires 4x faster than the
-// actual motor commutation frequency.
-#define BLDC_OL_TM_LO_SPD     (0x0B00 * CTIME_SCALAR) // start of ramp
+/*
+ * Driving the motor: duty-cycle control
+ */
+static uint16_t drive_dutycycle(void)
+{
+#ifdef VBATT_COMP_ENABLED
+  static uint8_t ctrl_tick = 0; // persistent count for sub-rating the control loop
+#endif
 
-//   0.000667 seconds / 24 / 0.25us = 111 counts
-#define LUDICROUS_SPEED       (0x006F * CTIME_SCALAR) // macro to determine this number from motor numbers?
+  uint16_t inp_dutycycle;
+
+#if defined( OL_TUNE_ENABLED )
+  // the sweep overrides the speed input (which must stay up, or the motor stops)
+  if (BL_TUNE_SWEEP == Tune_state)
+  {
+    inp_dutycycle = dc_slew( OL_TUNE_DC(Tune_knot) );
+  }
+  else
+#endif
+  {
+#if defined( GOVERNOR_ENABLED )
+    inp_dutycycle = dc_slew( governor(UI_speed) );
+#else
+    inp_dutycycle = dc_slew(UI_speed);
+#endif
+  }
 
+#ifdef VBATT_COMP_ENABLED
+  if ( 0 == ( ++ctrl_tick % VBATT_COMP_RATEM ) )
+  {
+    vbatt_comp_update();
+  }
+  // the compensated value sets both the PWM and the open-loop timing target
+  inp_dutycycle = vbatt_comp(inp_dutycycle);
+#endif
 
-// ramp rate derived from control rate which is derived from overall system rate
-// commutation time factor is rolled in there as well
-#define BLDC_ONE_RAMP_UNIT    (1 * CTRL_RATEM * CTIME_SCALAR)
+#if defined( CURRENT_SENSE_ENABLED )
+  inp_dutycycle = current_limit(inp_dutycycle);
+#endif
 
+  // refresh the duty-cycle and commutation period ... sets the pwm
+  // which will be upated to the PWM timer peripheral at next commutation point.
+  set_dutycycle( inp_dutycycle );
 
-/* Private types -----------------------------------------------------------*/
+  Commanded_Dutycycle = inp_dutycycle; // refresh the logger variable
 
-/* Public variables  ---------------------------------------------------------*/
+  return inp_dutycycle;
+}
 
-/* Private variables ---------------------------------------------------------*/
+#if defined( CATCH_ENABLED )
+/*
+ * CATCH entry: bridge is off (from READY) and the sequence is held while the
+ * back-EMF is sensed
+ */
+static void st_catch_entry(void)
+{
+  Catch_synced = FALSE;
+  Seq_Hold(TRUE);
+  Driver_Catch_arm(TRUE);
+}
 
-static uint16_t BLDC_OL_comm_tm;     // persistent value of ramp timing
+static void st_catch_exit(void)
+{
+  Driver_Catch_arm(FALSE);
+  Seq_Hold(FALSE);
+}
 
-static uint16_t Commanded_Dutycycle; // copied select DC to global for logging
+/*
+ * CATCH: once the electrical cycle of a spinning rotor is measured, the
+ * commutation step and timing are set from the present rotor position, and
+ * the duty-cycle from the open-loop table at the present speed, so the motor
+ * is driven from where it is (RUN). A rotor outside of the speed range of the
+ * table is not caught.
+ */
+static void st_catch(void)
+{
+  uint32_t perd;
+  uint32_t elapsed;
+  uint16_t ctm;
+  uint8_t qsect;
 
-static uint8_t UI_speed;             // input from UI task, file-scope for sm_update
+  if (FALSE == Catch_synced  &&  FALSE != Driver_Catch_get(&perd, &elapsed))
+  {
+    if ( perd >= ( (uint32_t)LUDICROUS_SPEED * CATCH_QSECTS )  &&
+         perd <= ( (uint32_t)BLDC_OL_TM_LO_SPD * CATCH_QSECTS ) )
+    {
+      ctm = (uint16_t)( perd / CATCH_QSECTS );
 
-static uint8_t Control_mode;   // indicates manual commuation buttons are active
+      qsect = (uint8_t)( ( CATCH_ZC_QSECT + (elapsed / ctm) ) % CATCH_QSECTS );
 
+      BLDC_OL_comm_tm = ctm;
+      Slew_dc = Get_OL_Dutycycle(ctm);
 
-/* Private function prototypes -----------------------------------------------*/
+      Seq_Set_step(qsect >> 2);
+      Driver_Set_qsector(qsect & 3, (uint16_t)( elapsed % ctm ));
 
+      Catch_synced = TRUE;
+    }
+  }
 
-/* Private functions ---------------------------------------------------------*/
+  if (FALSE != Catch_synced)
+  {
+    drive_dutycycle();
+  }
+  else
+  {
+    st_idle();
+  }
+}
+#endif // CATCH_ENABLED
 
-/**
- * @brief  Commutation timing ramp control.
- *
- * At each iteration the commutation time period is ramped to the target value
- * stepped in increment of +/- step depending on the sign of the error.
- *
- * @param   tgt_commutation_per  Target value to track.
+/*
+ * RAMP: the start ramp is on the commutation frequency
  */
-static void timing_ramp_control(uint16_t tgt_commutation_per)
+static void st_ramp(void)
 {
-  const uint8_t stepi = BLDC_ONE_RAMP_UNIT;
+  freq_ramp_control( Get_OL_Timing( drive_dutycycle() ) );
+}
 
-  uint16_t u16 = BLDC_OL_comm_tm;
+/*
+ * RUN: closed-loop control of commutation timing while the timing error is
+ * plausible, otherwise fall back to the open-loop table timing.
+ */
+static void st_run(void)
+{
+  uint16_t inp_dutycycle;
 
-  // determine signage of error i.e. step increment
-  if (u16 > tgt_commutation_per)
+#ifdef CLMODE_ENABLED
+  timing_mode_update();
+#endif
+  inp_dutycycle = drive_dutycycle();
+
+  // the period change per tick is limited in either mode
+  if (FALSE == Control_mode)
   {
-    u16 -= stepi;
-    if (u16 < tgt_commutation_per)
-    {
-      u16 = tgt_commutation_per;
-    }
-    BLDC_OL_comm_tm  = u16;
+    timing_ramp_control( Get_OL_Timing( inp_dutycycle ) );
   }
-  else if (u16 < tgt_commutation_per)
+  else
   {
-    u16 += stepi;
-    if (u16 > tgt_commutation_per)
-    {
-      u16 = tgt_commutation_per;
-    }
-    BLDC_OL_comm_tm  = u16;
+    timing_ramp_control( timing_control( Get_OL_Timing( inp_dutycycle ) ) );
+  }
+
+#if defined( OL_TUNE_ENABLED )
+  if (BL_TUNE_ARMED == Tune_state)
+  {
+    tune_knot_start(0);
+    Tune_state = BL_TUNE_SWEEP;
+  }
+  else if (BL_TUNE_SWEEP == Tune_state)
+  {
+    tune_update();
   }
+#endif
 }
 
 /*
- * BL_stop
- * common sub for stopping and fault states
+ * FAULT: do not pass go (the speed input is dropped every tick)
  */
-static void haltensie(void)
+static void st_fault(void)
 {
-// have to clear the local UI_speed since that is the transition OFF->RAMP condition
-  UI_speed = 0;
+  haltensie(); // sets UI speed 0
+  st_idle();
+}
 
-  // kill the driver signals
-  All_phase_stop();
+/*
+ * transition guards
+ */
+static uint8_t g_true(void)
+{
+  return TRUE;
+}
+
+static uint8_t g_fault(void)
+{
+  return (uint8_t)( 0 != Faultm_get_status() );
+}
+
+static uint8_t g_speed(void)
+{
+  return (uint8_t)( 0 != UI_speed );
+}
+
+static uint8_t g_stopped(void)
+{
+  return (uint8_t)( 0 == UI_speed );
+}
+
+static uint8_t g_aligned(void)
+{
+  return (uint8_t)( BL_state_ticks[ BL_ST_ALIGN ] >= ALIGN_TICKS );
+}
+
+// the start ramp has converged on the table timing of the duty-cycle
+static uint8_t g_ramp_done(void)
+{
+  return (uint8_t)( 0 != Commanded_Dutycycle  &&
+                    FALSE != ol_timing_synced( Commanded_Dutycycle ) );
+}
+
+// the speed input has been brought down to the shutoff following the fault
+static uint8_t g_rearm(void)
+{
+  return Rearm_req;
+}
+
+
+#if defined( CATCH_ENABLED )
+static uint8_t g_caught(void)
+{
+  return Catch_synced;
+}
+
+// not caught in time, or no back-EMF i.e. the rotor is at rest
+static uint8_t g_catch_tmo(void)
+{
+  uint16_t ticks = BL_state_ticks[ BL_ST_CATCH ];
+
+  return (uint8_t)( ticks >= CATCH_TICKS  ||
+                    ( ticks >= CATCH_STILL_TICKS  &&  FALSE == Driver_Catch_motion() ) );
 }
+#endif
 
 
 /* Public functions ---------------------------------------------------------*/
 
+/**
+ * @brief Stop the motor
+ *
+ * @details Kills the bridge immediately and drops the speed setting, but unlike
+ *  BL_reset() the fault state is retained. May be called from ISR.
+ */
+void BL_stop(void)
+{
+  haltensie();
+}
+
 /**
  * @brief Initialize/reset motor
  *
- *    System reset / re-arm function (has to be called both at program startup
- *    as well as following a fault condition state.
+ *    System reset / re-arm function (has to be called at program startup, a
+ *    fault is also re-armed by the speed input, see BLDC_PWMDC_Set).
  *
  * @details
  *    expect to be called from non-ISR/CS context (i.e. from  UI handler)
  */
 void BL_reset(void)
 {
-  // stop the system in case it is already running
-  haltensie();  //  zeros the  UI speed
-
-  // reset the system
-
-  // the commutation period (TIM3) apparantly has to be set to something (not 0)
-  // If TIM3 IE, the period must be long enough to ensure not saturated by ISR!
-
-  // Set initial commutation timing period upon state transition.
-  BLDC_OL_comm_tm = BLDC_OL_TM_LO_SPD;
+  Timing_pi.kp = TMCTRL_KP;
+  Timing_pi.ki = TMCTRL_KI;
+  Timing_pi.out_min = -TMCTRL_CORR_MAX;
+  Timing_pi.out_max = TMCTRL_CORR_MAX;
 
-  Faultm_init();
+#if defined( GOVERNOR_ENABLED )
+  Gov_pi.kp = GOV_KP;
+  Gov_pi.ki = GOV_KI;
+  Gov_pi.out_min = -GOV_CORR_MAX;
+  Gov_pi.out_max = GOV_CORR_MAX;
+#endif
 
-  Control_mode = FALSE;
-  // eventually it gets around to asserting the timer/PWM reset in the ISR update
-  // but explicitly handled here will be more deterministic
-//    set_dutycycle( PWM_0PCNT );
+  set_state(BL_ST_RESET);
 }
 
 
@@ -179,53 +1308,49 @@ void BL_reset(void)
  *
  * @details  Establishes the condition to transition from off->running. The motor
  *  is enabled to start once reaching the ramp speed threshold, and allowed to
- *  slow down to the low shutoff threshold.
+ *  slow down to the low shutoff threshold. At or below the shutoff the motor
+ *  is stopped (READY), and the speed input dropping to the shutoff re-arms from
+ *  FAULT (RESET), see the transition table.
  *  UI Speed is shared with background task so this function all should
  *  be invoked only from within a CS.
  *
- * @param dc Speed input which can be in the range [0:255] but 255 is to be
- *        reserved for special use (out of band value). If the PWM resolution
- *        changes then the input speed will have to be re-scaled accordingly.
+ * @param dc Speed input, duty-cycle command in the range [0:DC_100PCNT] which
+ *        is independent of the PWM resolution. Values above the range are
+ *        reserved for special use (out of band value e.g. PWM_BL_STOP).
+ *        The throttle curve is applied to the input.
  *
  * Now with low speed cut off !
  */
-void BLDC_PWMDC_Set(uint8_t dc)
+void BLDC_PWMDC_Set(uint16_t dc)
 {
 //    static uint8_t cl_timer = 0; // at 1K, 1 byte counter about 1/4 second
 
+  if (dc <= DC_100PCNT)
+  {
+    dc = Thr_curve_Apply(dc); // out of band values are passed through
+  }
+
   if (dc > PWM_DC_SHUTOFF)
   {
+    Input_on = TRUE;
+
     // Update the dc if speed input greater than ramp start, OR if system already running
     if ( dc > PWM_DC_CTRL_MODE  ||  0 != UI_speed )
     {
       UI_speed = dc;
-
-      // on speed change, check for condition to transition to closed loopo
-      if (FALSE == Control_mode)
-      {
-        /*
-         * checks a plausibility condition for transition to closed-loop
-         * control of commutation timing. Also considered imposing a minimum
-         * elapsed run-time but there is apparently no obvious reason to do such a thing.
-        */
-        if ( 0 == Seq_get_timing_error_p() )
-        {
-#ifdef CLMODE_ENABLED
-          Control_mode = TRUE;
-#endif
-        }
-      }
-      // else
-      // if dc < THRESHOLD, then unlatch control mode?
     }
   }
   else
   {
-    // reset needed in case system was running, in which case there is no
-    // going back .. has to ramp again to get started.
-    BL_reset(); // asserting this ... so what, system not running anyway!
+    // no going back once stopped .. has to ramp again to get started.
+    UI_speed = 0;
 
-    // assert (UI_speed == 0)  //  BL reset is supposed to set these initial conditions
+    // a fault is re-armed on the input coming down, not while it is held low
+    if (FALSE != Input_on  &&  BL_ST_FAULT == BL_state)
+    {
+      Rearm_req = TRUE;
+    }
+    Input_on = FALSE;
   }
 }
 
@@ -277,15 +1402,15 @@ uint16_t get_commutation_period(void)
  * @brief Accessor for state variable.
  *
  * @details
- *  External modules can query if the machine is running or not.
- *  There are only these two states bases on the set speed greater or less than
- *  the shutdown threshold.
+ *  External modules can query if the machine is running or not: the motor is
+ *  driven (ALIGN, RAMP or RUN), or the speed is set and it will start at the
+ *  next control tick.
  *
  * @return state value
  */
 BL_RUNSTATE_t BL_get_state(void)
 {
-  if (UI_speed > PWM_DC_SHUTOFF )
+  if ( (BL_state >= BL_ST_ALIGN && BL_state <= BL_ST_RUN)  ||  UI_speed > PWM_DC_SHUTOFF )
   {
     return BL_IS_RUNNING;
   }
@@ -293,16 +1418,75 @@ BL_RUNSTATE_t BL_get_state(void)
   return BL_NOT_RUNNING;
 }
 
+/**
+ * @brief Accessor for the state machine state.
+ *
+ * @return state
+ */
+BL_STATE_t BL_get_sm_state(void)
+{
+  return BL_state;
+}
+
+/**
+ * @brief Accessor for the time in state.
+ *
+ * @details Control ticks (~1 ms) from the latest entry to the state, i.e. the
+ *  duration of the last occurence of a state that has been left (saturates).
+ *
+ * @param state  State
+ *
+ * @return time in control ticks
+ */
+uint16_t BL_get_state_time(BL_STATE_t state)
+{
+  return BL_state_ticks[ state ];
+}
+
 uint8_t BL_get_ct_mode(void)
 {
   return Control_mode;
 }
 
+#if defined( OL_TUNE_ENABLED )
+/**
+ * @brief Arm the open-loop timing table tuning.
+ *
+ * @details Called from the background task with the motor stopped, the sweep
+ *  starts once the motor is running (RUN). The speed input must be held up
+ *  for the duration of the sweep, the motor being driven at the duty-cycle of
+ *  the sweep (up to OL_TUNE_DC_MAX) regardless of the speed input.
+ */
+void BL_Tune_arm(void)
+{
+  Tune_state = BL_TUNE_ARMED;
+}
+
+/**
+ * @brief Accessor for the open-loop timing table tuning status.
+ *
+ * @return  status
+ */
+BL_TUNE_t BL_Tune_status(void)
+{
+  return Tune_state;
+}
+
+/**
+ * @brief Acknowledge the result (or cancel) of the tuning.
+ */
+void BL_Tune_ack(void)
+{
+  Tune_state = BL_TUNE_IDLE;
+}
+#endif // OL_TUNE_ENABLED
+
 /**
  * @brief Periodic state machine update.
  *
  * @details
- * Called from TIM4 ISR. FRom the driver, the commutation-rate timer is being set
+ * Called from TIM4 ISR. Takes at most one transition per tick, then runs the
+ * action of the state. FRom the driver, the commutation-rate timer is being set
  * synchronous to this wihch is ideal, however, the control an probably be performed at
  * a lower rate (100Hz, 50Hz, 10Hz ..?). There is  no evident documentation of how this
  * timer rate came to be (TIM4 at ~ 0.5ms) Reducing it would give the commutation
@@ -312,58 +1496,23 @@ uint8_t BL_get_ct_mode(void)
  */
 void BLDC_Update(void)
 {
-  // 1 bit is /2 for sma, 1 bit is /2 for "gain"
-#define SMA_SH  1 // tmp
-#define GAIN_SH  2 // tmp
-  static const uint8_t CONTROL_GAIN_SH  = (GAIN_SH + SMA_SH);
-
-  static  int16_t timing_error ;
-  static uint8_t ctrl_tick = 0; // persistent count for sub-rating the control loop
-
-// does it need static previous copy of speed input to check for state transition?
-  uint16_t inp_dutycycle = 0; // intialize to 0
-
-  fault_status_reg_t  fm_status = Faultm_get_status();
-
-  if ( 0 == fm_status )
-  {
-    inp_dutycycle = UI_speed;
-  }
-  else
-  {
-    // do not pass go
-    haltensie(); // sets UI speed 0
-    // assert ... inp_dutycycle = 0;
-  }
-
-  // refresh the duty-cycle and commutation period ... sets the pwm
-  // which will be upated to the PWM timer peripheral at next commutation point.
-  set_dutycycle( inp_dutycycle );
+  uint8_t n;
 
-  // there isn't much point in enabling commuation timing contrl if speed is 0
-  // and by leaving it along until the system is actually running, it can set
-  // the initial condition in the global BL_Reset() above.
-  if (inp_dutycycle > 0    &&  ( 0 == fm_status ) )
+  for (n = 0; n < _SIZE_TRANS_TB; n++)
   {
-    if (FALSE == Control_mode)
+    if ( BL_state == BL_transition_tb[n].from  &&  FALSE != BL_transition_tb[n].guard() )
     {
-      timing_ramp_control( Get_OL_Timing( inp_dutycycle ) );
+      set_state( BL_transition_tb[n].to );
+      break;
     }
-    else
-    {
-      // the control gain is macro'd together with the unscaling of the error term and also /2 of the sma
-      uint16_t t16 = BLDC_OL_comm_tm ;
-      timing_error = ( Seq_get_timing_error() + timing_error ) >> CONTROL_GAIN_SH;
-      t16 += timing_error;
+  }
 
-// if this overshoots, the control runs away until the TIM3 becomes so low the system locks up and no faultm can work .. not failsafe!
-      if (t16 > LUDICROUS_SPEED)
-      {
-        BLDC_OL_comm_tm  = t16;
-      }
-    }
+  if (BL_state_ticks[ BL_state ] < U16_MAX)
+  {
+    BL_state_ticks[ BL_state ] += 1;
   }
-  Commanded_Dutycycle = inp_dutycycle; // refresh the logger variable
+
+  BL_state_tb[ BL_state ].action();
 }
 
 /**@}*/ // defgroup
@@ -0,0 +1,58 @@
+/**
+  ******************************************************************************
+  * @file crc8.c
+  * @brief CRC-8
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  */
+/**
+ * \defgroup crc8  CRC-8
+ * @brief CRC-8
+ *
+ * @details CRC-8 with polynomial x^8 + x^2 + x + 1 (0x07), initial value 0,
+ * bitwise (no table, the data is at most a few bytes). Used for the data
+ * EEPROM records and the ESC telemetry frame, which is specified with the same
+ * polynomial.
+ * @{
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+#include "crc8.h"
+
+
+/* Private defines -----------------------------------------------------------*/
+
+#define CRC8_POLY      0x07
+
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief CRC-8 of a buffer.
+ *
+ * @param p_data  Data
+ * @param len     Length of the data in bytes
+ *
+ * @return CRC-8
+ */
+uint8_t Crc8(const uint8_t * p_data, uint8_t len)
+{
+  uint8_t crc = 0;
+  uint8_t n;
+
+  while (len-- > 0)
+  {
+    crc ^= *p_data++;
+
+    for (n = 0; n < 8; n++)
+    {
+      crc = (uint8_t)( (0 != (crc & 0x80)) ? ((crc << 1) ^ CRC8_POLY) : (crc << 1) );
+    }
+  }
+  return crc;
+}
+
+/**@}*/ // defgroup
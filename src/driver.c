@@ -21,6 +21,10 @@
 #include "bldc_sm.h"
 #include "sequence.h"
 #include "per_task.h"
+#include "scope.h"
+#include "faultm.h"
+#include "dshot.h"
+#include "throttle.h"
 
 
 /* Private defines -----------------------------------------------------------*/
@@ -67,6 +71,82 @@
 
 #define FOUR_SECTORS  4 // each commutation sector of 60-degrees spans 4x TIM3 periods
 
+/*
+ * The sample is timestamped in the ADC EOC ISR, which is some time after the
+ * channel 0 conversion was actually sampled: the channels in the scan are
+ * converted at ~3.5us each (fADC 4 MHz, 14 cycles) plus the ISR latency.
+ * The timestamp is backdated by ~14us i.e. 0x38 * 0.25us, scaled to TIM3 counts.
+ */
+#define ADC_EOC_DELAY_TM  ( 0x38 * CTIME_SCALAR )
+
+#if defined( ZC_TIMING_ENABLED )
+/*
+ * Zero-crossing latch states: the first sample following the start of a sector
+ * is only a reference (the previous sample was taken with the prior switch state)
+ */
+#define ZC_IDLE     0
+#define ZC_ARMED    1
+#define ZC_LATCHED  2
+#endif
+
+#if defined( CATCH_ENABLED )
+/*
+ * Catching a spinning rotor: with the bridge off, phase A is sampled at every
+ * PWM period, i.e. the sample interval in commutation timer counts (8 per us).
+ * The zero-crossing reference is the middle of the envelope, with hysteresis
+ * of 1/8 of the envelope, once the envelope is large enough to be back-EMF.
+ */
+#define CATCH_SAMPLE_TM   ( (TIM2_PWM_PD * 8UL) / PWM_CNT_US )
+#define CATCH_BEMF_MIN    0x0040  // ~0.9 v
+#endif
+
+/*
+ * Shunt current sense, in raw ADC counts.
+ * 5 mOhm shunt, amplifier gain 20 -> 0.1 v/A
+ *  5v / 1024 counts = 4.9 mV per count   ... 20.5 counts/A
+ */
+#define ISENSE_ZERO     0x0008  // amplifier output offset at 0 current, until calibrated
+
+// current sense filter time constant, 2^4 PWM periods
+#define ISENSE_FILT_SH  4
+
+
+/*
+ * ADC calibration: the offset is subtracted from the phase voltage. The offset
+ * is only accepted with the rotor still, i.e. the samples are steady and near 0
+ * (a windmilling rotor puts the back-EMF on the floating phase).
+ */
+#define ADC_CAL_NSAMPLES_SH  4     // 16 samples (2 ms) are averaged for each measurement
+#define ADC_CAL_STILL_THR    8     // spread of the samples (counts), more is motion
+#define ADC_CAL_OFFSET_MAX   0x40  // more is not an offset (rotor turning, or a fault)
+#define ADC_CAL_TRIES        8     // measurements (~16 ms) before giving up
+
+#define ADC_CAL_TMO       0x1000  // loop counts, the PWM period is < 0x0400 loops
+
+/*
+ * Hard floor for the supply voltage, checked on each PWM period in which phase A
+ * is driven. Below the soft (leaky-bucket) undervoltage threshold in the
+ * background task, this is for a collapsing supply i.e. protect the power stage
+ * and the MCU rail.
+ */
+#if defined ( S105_DEV )
+#define V_BROWNOUT_THR      0x0300
+#else
+#define V_BROWNOUT_THR      0x02C0
+#endif
+
+#define V_BROWNOUT_DEBOUNCE  2 // consecutive samples
+
+/*
+ * Throttle latency is measured from the capture completing a throttle frame,
+ * through the control tick that applies it, to the PWM period in which the new
+ * duty-cycle takes effect, in PWM timer counts.
+ */
+#define LAT_IDLE       0
+#define LAT_CAPTURED   1  // frame captured, waiting for the control tick
+#define LAT_APPLIED    2  // applied, waiting for the PWM compare refresh
+
+#define LAT_PERIODS_MAX  0xF0 // ~30 ms, give up
 
 /* Private types -----------------------------------------------------------*/
 
@@ -78,6 +158,49 @@
 
 static uint16_t ADC_Global;
 
+// calibration offset, 0 until calibrated
+static uint16_t ADC_offset = 0;
+#if defined( ZC_TIMING_ENABLED )
+static uint16_t ADC_Global_tm; // timestamp of the sample, relative to start of sector
+#endif
+
+// time at start of the current 1/4 sector relative to start of sector
+static uint16_t Comm_qsector_tm;
+
+#if defined( S003_DEV ) && defined( HAS_SERVO_INPUT )
+// commutation timer periods accumulated, extends the counter for timestamps
+// of the servo pulse edges
+static uint32_t Comm_tm_base;
+
+static uint16_t Servo_start_tm;
+static uint16_t Servo_end_tm;
+#endif
+
+// index of the 1/4 sector within the commutation sector
+static uint8_t Comm_qsector;
+
+#if defined( CATCH_ENABLED )
+static uint8_t  Catch_armed;
+static uint8_t  Catch_below;   // sample has been below the reference
+static uint8_t  Catch_valid;   // consistent period of 2 electrical cycles
+static uint16_t Catch_prev;
+static uint16_t Catch_min;
+static uint16_t Catch_max;
+static uint32_t Catch_tm;      // time of the latest sample
+static uint32_t Catch_zc_tm;   // time of the latest rising zero-crossing
+static uint32_t Catch_perd;    // electrical cycle
+#endif
+
+#if defined( ZC_TIMING_ENABLED )
+// the back-EMF samples bracketing the zero-crossing
+static uint16_t ZC_ref;
+static uint16_t ZC_v0;
+static uint16_t ZC_t0;
+static uint16_t ZC_v1;
+static uint16_t ZC_t1;
+static uint8_t  ZC_state;
+#endif
+
 // Accummulates a string of 10-bit ADC samples for averaging - could reduce
 // to 8 bits as possibly the 2 lsb's are not that significant anyway.
 static uint16_t ph0_adc_fbuf[PH0_ADC_TBUF_SZ];
@@ -92,10 +215,113 @@ static uint16_t curr_pulse_start_tm;
 static uint16_t Pulse_perd;
 static uint16_t Pulse_dur;
 
+#if defined( CURRENT_SENSE_ENABLED )
+static uint16_t Isense_accum; // filtered current, scaled by 2^ISENSE_FILT_SH
+
+static uint16_t Isense_zero = ISENSE_ZERO;
+
+static uint8_t PWM_break_count;
+#endif
+
+#if defined( UNDERVOLTAGE_FAULT_ENABLED )
+static uint8_t Brownout_count;
+#endif
+
+#if defined( HAS_SERVO_INPUT )
+static uint8_t  Lat_state;
+static uint8_t  Lat_periods;   // PWM periods since the capture
+static uint16_t Lat_pwm_cnt;   // PWM timer count at the capture
+static uint16_t Lat_last;      // us
+static uint16_t Lat_max;
+#endif
+
 
 /* Private function prototypes -----------------------------------------------*/
 
 /* Private functions ---------------------------------------------------------*/
+
+#if defined( HAS_SERVO_INPUT )
+/*
+ * Throttle latency measurement, called at each PWM period following the
+ * compare refresh. The new duty-cycle is latched at the following update event
+ * i.e. 1 period after the refresh.
+ */
+static void latency_update(void)
+{
+  uint32_t lat;
+
+  if (LAT_IDLE == Lat_state)
+  {
+    return;
+  }
+
+  Lat_periods += 1;
+
+  if (LAT_APPLIED == Lat_state)
+  {
+    lat = (uint32_t)(Lat_periods + 1) * PWM_100PCNT - Lat_pwm_cnt;
+    Lat_last = (uint16_t)( lat / PWM_CNT_US );
+    if (Lat_last > Lat_max)
+    {
+      Lat_max = Lat_last;
+    }
+    Lat_state = LAT_IDLE;
+  }
+  else if (Lat_periods > LAT_PERIODS_MAX)
+  {
+    Lat_state = LAT_IDLE; // frame was not applied (e.g. not qualified)
+  }
+}
+
+/*
+ * Start the latency measurement on a captured throttle frame.
+ */
+static void latency_start(void)
+{
+  if (LAT_IDLE == Lat_state)
+  {
+    Lat_pwm_cnt = MCU_PWM_TIMER_CNT();
+    Lat_periods = 0;
+    Lat_state = LAT_CAPTURED;
+  }
+}
+#endif // HAS_SERVO_INPUT
+
+/*
+ * Time since the start of the commutation sector, in commutation timer counts.
+ * If the timer update is pending (i.e. the counter wrapped but the TIM3 ISR has
+ * not yet run) then the counter belongs to the following 1/4 sector.
+ */
+static uint16_t get_sector_tm(void)
+{
+  uint16_t count = MCU_COMM_TIMER_CNT();
+  uint16_t period = get_commutation_period();
+
+  if ( MCU_COMM_TIMER_UIF() && count < (period >> 1) )
+  {
+    count += period;
+  }
+  return Comm_qsector_tm + count;
+}
+
+#if defined( S003_DEV ) && defined( HAS_SERVO_INPUT )
+/*
+ * Free-running timestamp in commutation timer counts, i.e. the counter
+ * extended by the accumulated timer periods, handling a pending update as in
+ * get_sector_tm().
+ */
+static uint32_t get_comm_tm(void)
+{
+  uint16_t count = MCU_COMM_TIMER_CNT();
+  uint16_t period = get_commutation_period();
+
+  if ( MCU_COMM_TIMER_UIF() && count < (period >> 1) )
+  {
+    count += period;
+  }
+  return Comm_tm_base + count;
+}
+#endif
 #ifdef BUFFER_ADC_BEMF
 /*
  * averag 8 samples .. could be inline or macro
@@ -117,6 +343,91 @@ static void udpate_phase_average(void)
 }
 #endif
 
+#if !defined( S003_DEV )
+/*
+ * Trigger an ADC scan on the PWM edge and wait for the conversion, polling the
+ * timer and ADC flags i.e. with interrupts disabled (calibration only).
+ */
+static void adc_conv_sync(void)
+{
+  uint16_t tmo = ADC_CAL_TMO;
+
+  MCU_PWM_TIMER_UIF_CLR();
+  while ( !MCU_PWM_TIMER_UIF() && --tmo > 0 ) {;}
+
+  ADC1_ClearFlag(ADC1_FLAG_EOC);
+  ADC1_StartConversion();
+
+  tmo = ADC_CAL_TMO;
+  while ( RESET == ADC1_GetFlagStatus(ADC1_FLAG_EOC) && --tmo > 0 ) {;}
+
+  ADC1_ClearFlag(ADC1_FLAG_EOC);
+}
+
+/*
+ * Average of channel 0 over a number of PWM periods, and whether the rotor is
+ * still i.e. the samples are steady and near 0.
+ */
+static uint8_t adc_ch0_still(uint16_t * p_avg)
+{
+  uint16_t sum = 0;
+  uint16_t lo = U16_MAX;
+  uint16_t hi = 0;
+  uint16_t sample;
+  uint8_t n;
+
+  for (n = 0; n < (1 << ADC_CAL_NSAMPLES_SH); n++)
+  {
+    adc_conv_sync();
+    sample = ADC1_GetBufferValue( ADC1_CHANNEL_0 );
+    sum += sample; // 16 x 10-bits fits
+
+    if (sample < lo)
+    {
+      lo = sample;
+    }
+    if (sample > hi)
+    {
+      hi = sample;
+    }
+  }
+  *p_avg = sum >> ADC_CAL_NSAMPLES_SH;
+
+  return (uint8_t)( (hi - lo) <= ADC_CAL_STILL_THR  &&
+                    *p_avg <= ADC_CAL_OFFSET_MAX );
+}
+#endif // S003_DEV
+
+#if defined( UNDERVOLTAGE_FAULT_ENABLED )
+/*
+ * Fast supply check on the phase voltage sample. Phase A is driven (PWM) in
+ * commutation steps 0 and 1, so the sample taken at PWM on is Vbatt. The other
+ * steps are not counted either way.
+ */
+static void check_brownout(uint16_t sample)
+{
+  uint8_t step = Seq_Get_Step();
+
+  if ( (0 == step || 1 == step) && BL_IS_RUNNING == BL_get_state()  &&
+       BL_ST_CATCH != BL_get_sm_state() )
+  {
+    if (sample < V_BROWNOUT_THR)
+    {
+      if (++Brownout_count >= V_BROWNOUT_DEBOUNCE)
+      {
+        Brownout_count = 0;
+        BL_stop();
+        Faultm_set(VOLTAGE_NG);
+      }
+    }
+    else
+    {
+      Brownout_count = 0;
+    }
+  }
+}
+#endif
+
 /* External functions ---------------------------------------------------------*/
 
 #if defined( S105_DEV )
@@ -143,7 +454,19 @@ uint16_t get_pulse_end(void)
     return TIM1_GetCapture3();
 }
 
-#else // unimplemented ... stm8s003
+#elif defined( HAS_SERVO_INPUT ) // stm8s003 ... timestamped by EXTI
+
+uint16_t get_pulse_start(void)
+{
+    return Servo_start_tm;
+}
+
+uint16_t get_pulse_end(void)
+{
+    return Servo_end_tm;
+}
+
+#else
 
 uint16_t get_pulse_start(void)
 {
@@ -180,12 +503,65 @@ void Driver_on_capture_rise(void)
  */
 void Driver_on_capture_fall(void)
 {
+#if defined( DSHOT_ENABLED )
+  if (FALSE != Dshot_on_bit( get_pulse_start(), get_pulse_end() ))
+  {
+    latency_start();
+  }
+#else
 // noise on this signal when motor running
 //    uint16_t t16 =  TIM1_GetCapture3() - TIM1_GetCapture4();
 //    Pulse_dur = (Pulse_dur + t16) >> 1; // sma
   Pulse_dur = get_pulse_end() - get_pulse_start();
+
+  Throttle_on_pulse(Pulse_perd, Pulse_dur);
+
+#if defined( HAS_SERVO_INPUT )
+  latency_start();
+#endif
+#endif
 }
 
+#if defined( DSHOT_BIDIR )
+/**
+ * @brief Call from ISR on the servo timer compare (DShot telemetry bit).
+ */
+void Driver_on_servo_compare(void)
+{
+  Dshot_on_compare();
+}
+#endif
+
+#if defined( S003_DEV ) && defined( HAS_SERVO_INPUT )
+/**
+ * @brief Call from EXTI ISR on edge of the servo pulse.
+ *
+ * @details The S003 has no timer for input capture, the edge is timestamped
+ * against the commutation timer and passed on as a capture. The ISR is at the
+ * same priority as the commutation timer so it does not preempt it, and is
+ * short, only a counter read and a few adds ahead of the throttle decoding. An
+ * edge during the commutation ISR is delayed by it, which the median filter
+ * of the throttle width rejects.
+ *
+ * @param level  Servo pin level following the edge
+ */
+void Driver_on_servo_edge(uint8_t level)
+{
+  uint16_t tm = MCU_servo_tm( get_comm_tm() );
+
+  if (FALSE != level)
+  {
+    Servo_start_tm = tm;
+    Driver_on_capture_rise();
+  }
+  else
+  {
+    Servo_end_tm = tm;
+    Driver_on_capture_fall();
+  }
+}
+#endif
+
 /**
  * @brief Accessor for measured pulse period.
  */
@@ -202,6 +578,35 @@ uint16_t Driver_get_pulse_dur(void)
   return Pulse_dur;
 }
 
+#if defined( HAS_SERVO_INPUT )
+/**
+ * @brief Accessor for throttle latency.
+ *
+ * @details From the capture of the throttle frame to the PWM period in which
+ * the new duty-cycle takes effect.
+ *
+ * @return  Latency of the most recent measurement, us
+ */
+uint16_t Driver_Get_latency(void)
+{
+  return Lat_last;
+}
+
+/**
+ * @brief Accessor for maximum throttle latency.
+ *
+ * @details The maximum is cleared on read.
+ *
+ * @return  Maximum latency since the previous read, us
+ */
+uint16_t Driver_Get_latency_max(void)
+{
+  uint16_t lat = Lat_max;
+  Lat_max = 0;
+  return lat;
+}
+#endif
+
 
 /**
  * @brief  Hook for synchronizing to the PWM pulse.
@@ -227,7 +632,71 @@ void Driver_on_PWM_edge(void)
 
 // ADON = 1 for the 2nd time => starts the ADC conversion
   ADC1_StartConversion();
+
+  // duty-cycle set in the control tick takes effect at the next PWM period
+  PWM_Update_compare();
+
+#if defined( HAS_SERVO_INPUT )
+  latency_update();
+#endif
+}
+
+#if defined( CATCH_ENABLED )
+/*
+ * Rising back-EMF zero-crossings of the floating phase A (bridge off). The
+ * zero-crossing time is interpolated between the bracketing samples, and the
+ * electrical cycle is valid once 2 consecutive cycles agree within 1/4.
+ */
+static void catch_sample(uint16_t sample)
+{
+  uint16_t ref;
+  uint16_t env;
+  uint32_t zc_tm;
+  uint32_t perd;
+
+  Catch_tm += CATCH_SAMPLE_TM;
+
+  if (sample < Catch_min)
+  {
+    Catch_min = sample;
+  }
+  if (sample > Catch_max)
+  {
+    Catch_max = sample;
+  }
+
+  env = (Catch_max > Catch_min) ? (Catch_max - Catch_min) : 0;
+  ref = Catch_min + (env >> 1);
+
+  if (env >= CATCH_BEMF_MIN)
+  {
+    if ( sample < (ref - (env >> 3)) )
+    {
+      Catch_below = TRUE;
+    }
+    else if (FALSE != Catch_below  &&  sample >= ref)
+    {
+      // the previous sample is below the reference
+      Catch_below = FALSE;
+
+      zc_tm = Catch_tm -
+              ( ( (uint32_t)(sample - ref) * CATCH_SAMPLE_TM ) / (sample - Catch_prev) );
+
+      if (0 != Catch_zc_tm)
+      {
+        perd = zc_tm - Catch_zc_tm;
+
+        Catch_valid =
+          (uint8_t)( perd < (Catch_perd + (Catch_perd >> 2))  &&
+                     perd > (Catch_perd - (Catch_perd >> 2)) );
+        Catch_perd = perd;
+      }
+      Catch_zc_tm = zc_tm;
+    }
+  }
+  Catch_prev = sample;
 }
+#endif // CATCH_ENABLED
 
 /**
  * @brief  Capture ADC conversion channel 0 to buffer
@@ -238,7 +707,60 @@ void Driver_on_PWM_edge(void)
  */
 void Driver_on_ADC_conv(void)
 {
-  ADC_Global = ADC1_GetBufferValue( ADC1_CHANNEL_0 );
+#if defined( CURRENT_SENSE_ENABLED )
+  uint16_t isense = ADC1_GetBufferValue( ISENSE_ADC_CHANNEL );
+
+  // shunt is unipolar, clip at the amplifier offset
+  isense = (isense > Isense_zero) ? (isense - Isense_zero) : 0;
+
+  // running average: accum = accum * (1 - 1/2^N) + isense
+  Isense_accum = Isense_accum - (Isense_accum >> ISENSE_FILT_SH) + isense;
+#endif
+
+  uint16_t sample = ADC1_GetBufferValue( ADC1_CHANNEL_0 );
+  uint16_t tstamp = get_sector_tm();
+
+  // apply calibration: raw - offset
+  sample = (sample > ADC_offset) ? (sample - ADC_offset) : 0;
+
+  tstamp = (tstamp > ADC_EOC_DELAY_TM) ? (tstamp - ADC_EOC_DELAY_TM) : 0;
+
+#if defined( ZC_TIMING_ENABLED )
+  if (ZC_ARMED == ZC_state)
+  {
+    // latch the first pair of samples that bracket the reference
+    if ( (ADC_Global < ZC_ref) != (sample < ZC_ref) )
+    {
+      ZC_v0 = ADC_Global;
+      ZC_t0 = ADC_Global_tm;
+      ZC_v1 = sample;
+      ZC_t1 = tstamp;
+      ZC_state = ZC_LATCHED;
+    }
+  }
+  else if (ZC_IDLE == ZC_state)
+  {
+    ZC_state = ZC_ARMED;
+  }
+  ADC_Global_tm = tstamp;
+#endif
+
+  ADC_Global = sample;
+
+#if defined( CATCH_ENABLED )
+  if (FALSE != Catch_armed)
+  {
+    catch_sample(sample);
+  }
+#endif
+
+#if defined( UNDERVOLTAGE_FAULT_ENABLED )
+  check_brownout(sample);
+#endif
+
+#if defined( SCOPE_ENABLED )
+  Scope_Sample(sample, tstamp);
+#endif
 #ifdef BUFFER_ADC_BEMF
 // assert (buffer should be sized big enough for slowest speed)
 
@@ -264,6 +786,82 @@ uint16_t Driver_Get_Back_EMF_Avg(void)
   return phase_average;
 }
 #endif
+#if defined( CURRENT_SENSE_ENABLED )
+/**
+ * @brief Accessor for average current measurement.
+ * @details The shunt current is sampled on the same PWM synchronized scan as
+ * the phase voltage, i.e. it is the current during the PWM on-time.
+ * @return  Filtered current, ADC counts above the amplifier offset
+ */
+uint16_t Driver_Get_Current(void)
+{
+  return (Isense_accum >> ISENSE_FILT_SH);
+}
+
+/**
+ * @brief  Hook for the PWM break (hardware over-current limit).
+ *
+ * @details Called from the PWM timer break ISR. The output has already been
+ * cut in hardware, only the number of limited PWM cycles is counted here.
+ */
+void Driver_on_PWM_break(void)
+{
+  if (PWM_break_count < U8_MAX)
+  {
+    PWM_break_count += 1;
+  }
+}
+
+/**
+ * @brief  Get count of PWM cycles cut by the hardware current limit.
+ *
+ * @details The count is cleared on read, so should be called at a fixed rate
+ * (i.e. the background task).
+ * @return  PWM break count since the previous call
+ */
+uint8_t Driver_Get_PWM_breaks(void)
+{
+  uint8_t count = PWM_break_count;
+  PWM_break_count = 0;
+  return count;
+}
+#endif // CURRENT_SENSE_ENABLED
+
+#if !defined( S003_DEV )
+/**
+ * @brief Calibrate the phase voltage (and current sense) ADC offset.
+ *
+ * @details Called once at startup, following MCU init with the motor stopped
+ * and interrupts disabled. The channel offset is measured with the bridge off
+ * (phase A floating). If the rotor is turning the back-EMF is on the floating
+ * phase, so the measurement is repeated until the rotor is still, failing which
+ * the channels are left uncalibrated.
+ * The gain is not calibrated: there is no reference for the supply voltage, so
+ * the thresholds in raw ADC counts (V_SHUTDOWN_THR etc.) are subject to the
+ * tolerance of the divider and Vref.
+ */
+void Driver_ADC_calibrate(void)
+{
+  uint16_t offset;
+  uint8_t n;
+
+  All_phase_stop();
+
+  for (n = 0; n < ADC_CAL_TRIES; n++)
+  {
+    if (FALSE != adc_ch0_still(&offset))
+    {
+      ADC_offset = offset;
+#if defined( CURRENT_SENSE_ENABLED )
+      // no current with the bridge off, so whatever is read is the amplifier offset
+      Isense_zero = ADC1_GetBufferValue( ISENSE_ADC_CHANNEL );
+#endif
+      break;
+    }
+  }
+}
+#endif // S003_DEV
+
 /**
  * @brief Accessor for system voltage measurement.
  * @details the phase voltage measurement from ADC Channel 0 is to be used as
@@ -275,6 +873,57 @@ uint16_t Driver_Get_ADC(void)
   return ADC_Global;
 }
 
+#if defined( ZC_TIMING_ENABLED )
+/**
+ * @brief Set the reference voltage for the back-EMF zero-crossing.
+ * @details Nominally 1/2 Vbatt, in ADC counts.
+ * @param  ref  ADC counts
+ */
+void Driver_Set_ZC_ref(uint16_t ref)
+{
+  ZC_ref = ref;
+}
+
+/**
+ * @brief Get time of back-EMF zero-crossing in the current sector.
+ *
+ * @details The zero-crossing time is linearly interpolated between the
+ * timestamps of the two samples which bracket the zero-crossing reference.
+ * Only the first crossing following the start of the sector is latched, so
+ * this is meaningful in the sector in which the measured phase is floating
+ * and should be called before the sector ends (i.e. in sequencer step).
+ *
+ * @return  Commutation timer counts relative to start of sector, or U16_MAX
+ *          if no crossing was found
+ */
+uint16_t Driver_Get_ZC_tm(void)
+{
+  uint16_t dv;
+  uint16_t dref;
+  uint16_t dt;
+
+  if (ZC_LATCHED != ZC_state)
+  {
+    return U16_MAX;
+  }
+
+  // the samples bracket the reference so dv != 0, and dref <= dv
+  if (ZC_v1 > ZC_v0)
+  {
+    dv = ZC_v1 - ZC_v0;
+    dref = ZC_ref - ZC_v0;
+  }
+  else
+  {
+    dv = ZC_v0 - ZC_v1;
+    dref = ZC_v0 - ZC_ref;
+  }
+  dt = ZC_t1 - ZC_t0;
+
+  return ZC_t0 + (uint16_t)( ((uint32_t)dt * dref) / dv );
+}
+#endif // ZC_TIMING_ENABLED
+
 /**
  * @brief  Update background task and system state.
  *
@@ -294,7 +943,19 @@ void Driver_Update(void)
   // timer rate) presently ths update done every 1.024mS so the controller rate ~1Khz
   if ( 0 != ( ++trate & 0x01 ) )
   {
+#if defined( DSHOT_ENABLED )
+    Dshot_Update(); // throttle is applied at the control rate
+#elif defined( HAS_SERVO_INPUT )
+    Throttle_Update();
+#endif
     BLDC_Update();
+
+#if defined( HAS_SERVO_INPUT )
+    if (LAT_CAPTURED == Lat_state)
+    {
+      Lat_state = LAT_APPLIED;
+    }
+#endif
   }
   else if ( 0 == (trate % UI_UPDATEM))
   {
@@ -325,31 +986,119 @@ void Driver_Update(void)
  */
 void Driver_Step(void)
 {
-  static const int SectorC = FOUR_SECTORS;
-  static int index = 0;
-
 // Since the modulus being used (4) is a power of 2, then a bitwise & can be used
 // instead of a MOD (%) to save a few instructions, which is actually significant
 // as this is a very high frequency ISR!
-  index = (index + 1) & (SectorC - 1);
+  Comm_qsector = (Comm_qsector + 1) & (FOUR_SECTORS - 1);
+
+#if defined( S003_DEV ) && defined( HAS_SERVO_INPUT )
+  Comm_tm_base += get_commutation_period();
+#endif
 
 // Distribute the work done in the ISR by partitioning
 //  sequence_step, memcpy,  get_ADC into  separate sub-steps
 // Logically the call to Sequence_Step() occurs following the memcpy()
 
-  switch(index)
+  switch(Comm_qsector)
   {
   case 0:
 #ifdef BUFFER_ADC_BEMF
     udpate_phase_average(); // average 8 samples from frame buffer
 #endif
     Sequence_Step();
+
+    // timestamps are relative to the start of the new sector
+    Comm_qsector_tm = 0;
+#if defined( ZC_TIMING_ENABLED )
+    ZC_state = ZC_IDLE;
+#endif
     break;
 
   case 1:
   case 2:
   case 3:
+    Comm_qsector_tm += get_commutation_period();
     break;
   }
 }
+
+#if defined( CATCH_ENABLED )
+/**
+ * @brief Start/stop sensing of a spinning rotor.
+ *
+ * @details Called from the control task with the bridge off.
+ *
+ * @param enable  TRUE to start over
+ */
+void Driver_Catch_arm(uint8_t enable)
+{
+  Catch_armed = FALSE; // sampling ISR is held off while resetting
+
+  Catch_below = FALSE;
+  Catch_valid = FALSE;
+  Catch_min = U16_MAX;
+  Catch_max = 0;
+  Catch_tm = 0;
+  Catch_zc_tm = 0;
+  Catch_perd = 0;
+
+  Catch_armed = enable;
+}
+
+/**
+ * @brief Accessor for the back-EMF of a spinning rotor.
+ *
+ * @return  TRUE if the phase voltage envelope is large enough to be back-EMF
+ */
+uint8_t Driver_Catch_motion(void)
+{
+  return (uint8_t)( Catch_max > Catch_min  &&  (Catch_max - Catch_min) >= CATCH_BEMF_MIN );
+}
+
+/**
+ * @brief Accessor for the speed and position of a spinning rotor.
+ *
+ * @details Called from the control task, which runs ahead of the sample of
+ *  the present PWM period, so the present time is the latest sample + 1.
+ *
+ * @param p_perd     Electrical cycle, commutation timer counts
+ * @param p_elapsed  Time since the latest rising zero-crossing of phase A
+ *
+ * @return  TRUE if valid
+ */
+uint8_t Driver_Catch_get(uint32_t * p_perd, uint32_t * p_elapsed)
+{
+  if (FALSE == Catch_valid)
+  {
+    return FALSE;
+  }
+  *p_perd = Catch_perd;
+  *p_elapsed = Catch_tm + CATCH_SAMPLE_TM - Catch_zc_tm;
+
+  return TRUE;
+}
+
+/**
+ * @brief Phase the commutation timing to a caught rotor.
+ *
+ * @details Sets the 1/4 sector index within the commutation sector and the
+ *  time into the present 1/4 sector, so that the commutation switch is on time.
+ *
+ * @param qsector  1/4 sector index
+ * @param elapsed  Time into the 1/4 sector, commutation timer counts
+ */
+void Driver_Set_qsector(uint8_t qsector, uint16_t elapsed)
+{
+  uint16_t period = get_commutation_period();
+
+  Comm_qsector = qsector & (FOUR_SECTORS - 1);
+  Comm_qsector_tm = Comm_qsector * period;
+#if defined( ZC_TIMING_ENABLED )
+  ZC_state = ZC_IDLE;
+#endif
+
+  MCU_phase_comm_timer(period, elapsed);
+}
+#endif // CATCH_ENABLED
+
 /**@}*/ // defgroup
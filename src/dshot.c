@@ -0,0 +1,487 @@
+/**
+  ******************************************************************************
+  * @file dshot.c
+  * @brief DShot digital throttle protocol
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  */
+/**
+ * \defgroup dshot  DShot
+ * @brief DShot digital throttle protocol
+ *
+ * @details A DShot frame is 16 bits, MSB first:
+ *   11-bit throttle value | 1-bit telemetry request | 4-bit CRC
+ * Each bit is a pulse of fixed period, the high time being 3/4 of the period for
+ * a 1 and 3/8 of the period for a 0. Frames are separated by an idle gap.
+ *
+ * The servo input capture channels are reused: rising edge on the direct
+ * channel and falling edge on the indirect channel of the same pin, with the
+ * timer prescaler at 1. Only the falling edge interrupt is enabled, which reads
+ * both captures, so there is 1 ISR per bit. At 16 Mhz this allows DShot150
+ * (6.67us per bit i.e. ~100 CPU cycles); DShot300 is possible only if no other
+ * ISR is allowed to delay the capture ISR by more than 1 bit period, which is
+ * not the case here (no DMA on STM8S).
+ *
+ * Bidirectional DShot (DSHOT_BIDIR) inverts the signal (idle high, bit starts
+ * on the falling edge) and the CRC. Following each valid frame the pin is
+ * switched to output and the eRPM is sent back 30 us after the end of the
+ * frame, at 5/4 the bit rate: the electrical period in us as a 3-bit exponent
+ * and 9-bit mantissa, with inverted CRC, GCR coded (4 bits to 5) and sent as
+ * transitions. The response is timed by a compare channel of the capture
+ * timer, 1 bit per compare interrupt, so the capture ISR returns at the end of
+ * the frame. The motor ISRs are set to a lower priority than the servo timer
+ * ISR (see MCU_Init) so the bit edges are not held off by the control task.
+ * @{
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "dshot.h"
+
+#if defined( DSHOT_ENABLED ) || defined( UNIT_TEST )
+
+#if !defined( UNIT_TEST )
+#include "bldc_sm.h"
+#include "mcu_stm8s.h"
+#endif
+
+
+/* Private defines -----------------------------------------------------------*/
+
+// timer counts per us with capture prescaler of 1
+#ifdef CLOCK_16
+#define DSHOT_TCK_US     16
+#else
+#define DSHOT_TCK_US     8
+#endif
+
+#if !defined( DSHOT_RATE )
+#define DSHOT_RATE  150
+#endif
+
+#if DSHOT_RATE == 300
+#define DSHOT_BIT_TCK    (DSHOT_TCK_US * 10 / 3)  // 3.33 us
+#else
+#define DSHOT_BIT_TCK    (DSHOT_TCK_US * 20 / 3)  // 6.67 us
+#endif
+
+#if DSHOT_RATE == 300
+#define DSHOT_TELEM_BIT_TCK  (DSHOT_TCK_US * 8 / 3)   // 2.67 us
+#else
+#define DSHOT_TELEM_BIT_TCK  (DSHOT_TCK_US * 16 / 3)  // 5.33 us
+#endif
+
+// telemetry response starts this long after the end of the frame
+#define DSHOT_TELEM_DELAY_TCK  (DSHOT_TCK_US * 30)
+
+// bidirectional frames have the CRC inverted, telemetry frames always
+#if defined( DSHOT_BIDIR )
+#define DSHOT_CRC_INV    0x0F
+#else
+#define DSHOT_CRC_INV    0
+#endif
+
+#define DSHOT_TELEM_CRC_INV  0x0F
+
+// eRPM period is 9-bit mantissa shifted by 3-bit exponent
+#define DSHOT_ERPM_MANT_BITS  9
+#define DSHOT_ERPM_MANT_MAX   ( (1 << DSHOT_ERPM_MANT_BITS) - 1 )
+
+// high time threshold between 0 (3/8 bit period) and 1 (3/4 bit period)
+#define DSHOT_BIT1_THR   ( (DSHOT_BIT_TCK * 9) / 16 )
+
+// rising edges spaced longer than this are the gap between frames
+#define DSHOT_GAP_TCK    ( (DSHOT_BIT_TCK * 3) / 2 )
+
+// bit count to indicate waiting for the inter-frame gap
+#define DSHOT_SYNC_WAIT  0xFF
+
+// telemetry bit count to indicate no response being sent
+#define DSHOT_TX_IDLE    0xFF
+
+// special commands must be received this many times in a row to be accepted
+#define DSHOT_CMD_REPEAT  6
+
+// no valid frame for this many update periods (~1ms) is loss of signal (~50ms)
+#define DSHOT_TIMEOUT    50
+
+
+/* Private variables ---------------------------------------------------------*/
+
+// GCR code by nibble
+static const uint8_t Gcr_tb[16] =
+{
+  0x19, 0x1B, 0x12, 0x13, 0x1D, 0x15, 0x16, 0x17,
+  0x1A, 0x09, 0x0A, 0x0B, 0x1E, 0x0D, 0x0E, 0x0F
+};
+
+#if !defined( UNIT_TEST )
+
+static uint16_t Frame_accum;
+static uint16_t Prev_rise;
+static uint8_t  Bit_count = DSHOT_SYNC_WAIT;
+
+static uint16_t Frame_raw;     // latched complete frame
+static uint8_t  Frame_ready;
+
+static uint16_t Throttle;      // last valid throttle value [0:2047]
+static uint8_t  Timeout_count;
+static uint8_t  Telem_req;     // telemetry bit of the last valid frame
+
+static uint8_t  Cmd_prev = DSHOT_CMD_NONE;
+static uint8_t  Cmd_count;
+static dshot_cmd_t Command = DSHOT_CMD_NONE;
+
+#if defined( DSHOT_BIDIR )
+// response to the next frame, double buffered as the driver update is
+// preempted by the servo timer ISR
+static uint32_t Telem_line[2];
+static uint8_t  Telem_idx;
+
+static uint32_t Tx_line;       // response being sent
+static uint16_t Tx_tm;         // compare time of the next bit
+static uint8_t  Tx_count = DSHOT_TX_IDLE;
+#endif
+
+#endif // UNIT_TEST
+
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Compute DShot CRC.
+ *
+ * @param value  12-bit value (throttle and telemetry bit)
+ * @return  4-bit CRC
+ */
+uint16_t Dshot_crc(uint16_t value)
+{
+  return (value ^ (value >> 4) ^ (value >> 8)) & 0x0F;
+}
+
+/**
+ * @brief Encode a DShot frame.
+ *
+ * @param value  11-bit throttle value
+ * @param telem  Telemetry request bit
+ * @return  16-bit frame
+ */
+uint16_t Dshot_encode(uint16_t value, uint8_t telem)
+{
+  uint16_t v = (uint16_t)((value << 1) | (0 != telem));
+
+  return (uint16_t)((v << 4) | (Dshot_crc(v) ^ DSHOT_CRC_INV));
+}
+
+/**
+ * @brief Decode a DShot frame.
+ *
+ * @param frame    16-bit frame
+ * @param p_telem  Pointer to telemetry request bit (may be NULL)
+ * @return  11-bit throttle value, or -1 if the CRC does not match
+ */
+int16_t Dshot_decode(uint16_t frame, uint8_t * p_telem)
+{
+  uint16_t v = frame >> 4;
+
+  if ( (Dshot_crc(v) ^ DSHOT_CRC_INV) != (frame & 0x0F) )
+  {
+    return -1;
+  }
+  if ( 0 != p_telem )
+  {
+    *p_telem = (uint8_t)(v & 1);
+  }
+  return (int16_t)(v >> 1);
+}
+
+/**
+ * @brief Encode the electrical period as the eRPM telemetry value.
+ *
+ * @param period_us  Electrical period in us (U16_MAX if stopped)
+ * @return  12-bit value: 3-bit exponent, 9-bit mantissa
+ */
+uint16_t Dshot_erpm_encode(uint16_t period_us)
+{
+  uint16_t e = 0;
+
+  while (period_us > DSHOT_ERPM_MANT_MAX)
+  {
+    period_us >>= 1;
+    e += 1;
+  }
+  return (uint16_t)((e << DSHOT_ERPM_MANT_BITS) | period_us);
+}
+
+/**
+ * @brief Encode the telemetry response.
+ *
+ * @details The 12-bit value and inverted CRC are GCR coded, then converted to
+ * line levels where a 1 is a transition, following the start bit (low).
+ *
+ * @param value  12-bit value
+ * @return  Line levels, MSB (start bit) first in bit 20
+ */
+uint32_t Dshot_telem_encode(uint16_t value)
+{
+  uint16_t frame;
+  uint32_t gcr = 0;
+  uint32_t line = 0;
+  uint8_t level = 0;
+  uint8_t n;
+
+  value &= 0x0FFF;
+  frame = (uint16_t)((value << 4) | (Dshot_crc(value) ^ DSHOT_TELEM_CRC_INV));
+
+  for (n = 0; n < 4; n++)
+  {
+    gcr = (gcr << 5) | Gcr_tb[ (frame >> 12) & 0x0F ];
+    frame <<= 4;
+  }
+
+  for (n = 0; n < (DSHOT_TELEM_BITS - 1); n++)
+  {
+    level ^= (uint8_t)( (gcr >> (DSHOT_TELEM_BITS - 2 - n)) & 1 );
+    line = (line << 1) | level;
+  }
+  return line; // start bit (0) is bit 20
+}
+
+#if !defined( UNIT_TEST )
+
+#if defined( DSHOT_BIDIR )
+/*
+ * Electrical period in us from the commutation period.
+ */
+static uint16_t get_eperiod_us(void)
+{
+  uint32_t us;
+
+  if (BL_IS_RUNNING != BL_get_state())
+  {
+    return U16_MAX;
+  }
+
+  us = ( (uint32_t)get_commutation_period() * COMM_QSECT_PER_CYCLE ) /
+       COMM_CNT_US;
+
+  return (us > U16_MAX) ? U16_MAX : (uint16_t)us;
+}
+
+/**
+ * @brief Send the next bit of the telemetry response.
+ *
+ * @details Called from the servo timer compare ISR. The 1st compare is the end
+ * of the turnaround, at which the pin is switched to output. The compare is
+ * advanced by 1 bit period for the next bit, and disabled following the last
+ * bit with the pin returned to capture input.
+ */
+void Dshot_on_compare(void)
+{
+  if (DSHOT_TELEM_BITS == Tx_count)
+  {
+    MCU_SERVO_PIN_SET(1); // idle
+    MCU_set_servo_output(FALSE);
+    MCU_set_servo_compare(FALSE, 0);
+    Tx_count = DSHOT_TX_IDLE;
+    return;
+  }
+
+  if (0 == Tx_count)
+  {
+    MCU_set_servo_output(TRUE);
+  }
+
+  MCU_SERVO_PIN_SET( Tx_line & ((uint32_t)1 << (DSHOT_TELEM_BITS - 1)) );
+  Tx_line <<= 1;
+  Tx_count += 1;
+
+  Tx_tm += DSHOT_TELEM_BIT_TCK;
+  MCU_set_servo_compare(TRUE, Tx_tm);
+}
+#endif // DSHOT_BIDIR
+
+/**
+ * @brief Accumulate 1 bit of the DShot frame.
+ *
+ * @details Called from the capture ISR on the falling edge, with the capture of
+ * the rising edge and the falling edge. Frame sync is on the inter-frame gap
+ * i.e. the 1st rising edge following the gap is the MSB.
+ *
+ * @param rise  Timer capture on the rising edge
+ * @param fall  Timer capture on the falling edge
+ * @return  TRUE if the bit completed a frame
+ */
+uint8_t Dshot_on_bit(uint16_t rise, uint16_t fall)
+{
+  // 16-bit timer is free-running so no concern for sign of the result
+  uint16_t perd = rise - Prev_rise;
+
+  Prev_rise = rise;
+
+  if (perd > DSHOT_GAP_TCK)
+  {
+    Bit_count = 0;
+    Frame_accum = 0;
+  }
+  else if (DSHOT_SYNC_WAIT == Bit_count)
+  {
+    return FALSE;
+  }
+
+  Frame_accum <<= 1;
+
+  if ( (uint16_t)(fall - rise) > DSHOT_BIT1_THR )
+  {
+    Frame_accum |= 1;
+  }
+
+  if (++Bit_count >= DSHOT_FRAME_BITS)
+  {
+    Bit_count = DSHOT_SYNC_WAIT;
+
+    // the latched frame is not overwritten until it is read by the update
+    if (FALSE == Frame_ready)
+    {
+      Frame_raw = Frame_accum;
+      Frame_ready = TRUE;
+    }
+
+#if defined( DSHOT_BIDIR )
+    // respond only to a valid frame, timed from the end of the last bit
+    if (DSHOT_TX_IDLE == Tx_count  &&  Dshot_decode(Frame_accum, 0) >= 0)
+    {
+      Tx_line = Telem_line[ Telem_idx ];
+      Tx_count = 0;
+      Tx_tm = (uint16_t)(rise + DSHOT_BIT_TCK + DSHOT_TELEM_DELAY_TCK);
+      MCU_set_servo_compare(TRUE, Tx_tm);
+    }
+#endif
+    return TRUE;
+  }
+  return FALSE;
+}
+
+/**
+ * @brief Apply the received DShot frame.
+ *
+ * @details Called from the driver update (ISR, ~1ms). The latched frame
+ * is validated and the throttle passed to the BLDC speed setting, so the
+ * throttle updates at the rate of the control task rather than the background
+ * task. Throttle value 0 or a command stops the motor. If no valid frame is
+ * received within the timeout the motor is stopped.
+ */
+void Dshot_Update(void)
+{
+  int16_t value = -1;
+  uint8_t telem = FALSE;
+
+#if defined( DSHOT_BIDIR )
+  Telem_line[ Telem_idx ^ 1 ] =
+    Dshot_telem_encode( Dshot_erpm_encode( get_eperiod_us() ) );
+  Telem_idx ^= 1;
+#endif
+
+  if (FALSE != Frame_ready)
+  {
+    value = Dshot_decode(Frame_raw, &telem);
+    Frame_ready = FALSE;
+  }
+
+  if (value >= 0  &&  FALSE != telem)
+  {
+    Telem_req = TRUE;
+  }
+
+  if (value < 0)
+  {
+    // CRC error or no new frame
+    if (Timeout_count < DSHOT_TIMEOUT)
+    {
+      Timeout_count += 1;
+    }
+    else if (0 != Throttle)
+    {
+      Throttle = 0;
+      BLDC_PWMDC_Set(0);
+    }
+    return;
+  }
+
+  Timeout_count = 0;
+
+  if (DSHOT_CMD_MOTOR_STOP == value)
+  {
+    Cmd_prev = DSHOT_CMD_NONE;
+    Throttle = 0;
+    BLDC_PWMDC_Set(0);
+  }
+  else if (value <= DSHOT_CMD_MAX)
+  {
+    // commands are only accepted following the required number of repeats
+    if ((uint8_t)value == Cmd_prev)
+    {
+      if (++Cmd_count == DSHOT_CMD_REPEAT)
+      {
+        Command = (dshot_cmd_t)value;
+      }
+    }
+    else
+    {
+      Cmd_prev = (uint8_t)value;
+      Cmd_count = 1;
+    }
+    Throttle = 0;
+    BLDC_PWMDC_Set(0);
+  }
+  else
+  {
+    Cmd_prev = DSHOT_CMD_NONE;
+    Throttle = (uint16_t)value;
+    BLDC_PWMDC_Set( DSHOT_DC(Throttle) );
+  }
+}
+
+/**
+ * @brief Accessor for DShot throttle value.
+ *
+ * @return  Last valid throttle value [48:2047], 0 if stopped
+ */
+uint16_t Dshot_Get_throttle(void)
+{
+  return Throttle;
+}
+
+/**
+ * @brief Get the last accepted DShot command.
+ *
+ * @details The command is cleared on read.
+ * @return  DShot command, DSHOT_CMD_NONE if none received
+ */
+dshot_cmd_t Dshot_Get_command(void)
+{
+  dshot_cmd_t cmd = Command;
+  Command = DSHOT_CMD_NONE;
+  return cmd;
+}
+
+/**
+ * @brief Get the telemetry request.
+ *
+ * @details Set by a valid frame with the telemetry bit, cleared on read
+ * (polled by the telemetry task in the background task).
+ * @return  TRUE if serial telemetry is requested
+ */
+uint8_t Dshot_Get_telem_req(void)
+{
+  uint8_t req = Telem_req;
+  Telem_req = FALSE;
+  return req;
+}
+
+#endif // UNIT_TEST
+
+#endif // DSHOT_ENABLED || UNIT_TEST
+
+/**@}*/ // defgroup
@@ -0,0 +1,144 @@
+/**
+  ******************************************************************************
+  * @file eeprom.c
+  * @brief Data EEPROM records
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  */
+/**
+ * \defgroup eeprom  EEPROM
+ * @brief Data EEPROM records
+ *
+ * @details Settings are stored as records at fixed offsets in the data EEPROM,
+ * each followed by a CRC-8 so that an erased or partially written record is
+ * not used. The data EEPROM is memory mapped for read, and written a byte at
+ * a time following the unlock sequence, at register level as the SPL flash
+ * driver is not built in this project.
+ *
+ * Writing a byte takes a few ms, so records are only saved from the
+ * background task with the motor stopped.
+ * @{
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "eeprom.h"
+#include "crc8.h"
+
+
+/* Private defines -----------------------------------------------------------*/
+
+#define EE_BASE_ADDR   0x4000
+
+#define EE_PTR( _OFFS_ )  ( (volatile uint8_t *)(EE_BASE_ADDR + (_OFFS_)) )
+
+// data EEPROM unlock keys (MASS keys are in reverse order of the program memory)
+#define EE_KEY1        0xAE
+#define EE_KEY2        0x56
+
+// loop count to wait for the unlock or the end of programming (byte write is
+// ~6 ms worst case)
+#define EE_TMO         0xFFFF
+
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * Program 1 byte, returns FALSE on timeout.
+ */
+static uint8_t write_byte(uint8_t offs, uint8_t value)
+{
+  uint16_t tmo = EE_TMO;
+
+  if (value == *EE_PTR(offs))
+  {
+    return TRUE; // spare the write cycle
+  }
+
+  *EE_PTR(offs) = value;
+
+  while ( 0 == (FLASH->IAPSR & FLASH_IAPSR_EOP) )
+  {
+    if (0 == --tmo)
+    {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Load a record.
+ *
+ * @param offs   Offset of the record in the data EEPROM
+ * @param p_rec  Pointer to the record
+ * @param len    Size of the record (not including the CRC)
+ * @return  TRUE if the CRC matches, otherwise the record is not to be used
+ */
+uint8_t Eeprom_Load(uint8_t offs, void * p_rec, uint8_t len)
+{
+  uint8_t * p_data = (uint8_t *)p_rec;
+  uint8_t n;
+
+  for (n = 0; n < len; n++)
+  {
+    p_data[n] = *EE_PTR(offs + n);
+  }
+
+  return (uint8_t)( *EE_PTR(offs + len) == Crc8(p_data, len) );
+}
+
+/**
+ * @brief Save a record.
+ *
+ * @details Blocks for up to a few ms per byte, so must not be called from ISR
+ * or with the motor running.
+ *
+ * @param offs   Offset of the record in the data EEPROM
+ * @param p_rec  Pointer to the record
+ * @param len    Size of the record (not including the CRC)
+ * @return  TRUE if written
+ */
+uint8_t Eeprom_Save(uint8_t offs, const void * p_rec, uint8_t len)
+{
+  const uint8_t * p_data = (const uint8_t *)p_rec;
+  uint16_t tmo = EE_TMO;
+  uint8_t ok = TRUE;
+  uint8_t n;
+
+  if ( (uint16_t)offs + len + 1 > EE_OFFS_END )
+  {
+    return FALSE;
+  }
+
+  FLASH->DUKR = EE_KEY1;
+  FLASH->DUKR = EE_KEY2;
+
+  while ( 0 == (FLASH->IAPSR & FLASH_IAPSR_DUL) )
+  {
+    if (0 == --tmo)
+    {
+      return FALSE;
+    }
+  }
+
+  for (n = 0; n < len && FALSE != ok; n++)
+  {
+    ok = write_byte(offs + n, p_data[n]);
+  }
+
+  if (FALSE != ok)
+  {
+    ok = write_byte(offs + len, Crc8(p_data, len));
+  }
+
+  FLASH->IAPSR &= (uint8_t)~FLASH_IAPSR_DUL; // lock
+
+  return ok;
+}
+
+/**@}*/ // defgroup
@@ -105,6 +105,31 @@ static faultm_mat_t fault_matrix[ NR_DEFINED_FAULTS ];
 
 /* Private functions ---------------------------------------------------------*/
 
+/**
+ * @brief Get the fault matrix entry of a fault ID.
+ *
+ * @details The fault IDs are bit-positions in the status word, so the fault
+ * matrix is indexed by the bit number, not by the ID value (indexing by the
+ * ID value would overrun the matrix for anything above bit 2).
+ *
+ * @param faultm_ID  Numerical ID of the fault.
+ *
+ * @return pointer to fault matrix entry
+ */
+static faultm_mat_t * get_fault_entry(faultm_ID_t faultm_ID)
+{
+    uint8_t mask = (uint8_t) faultm_ID;
+    uint8_t index = 0;
+
+    while ( mask > 1 )
+    {
+        mask >>= 1;
+        index += 1;
+    }
+// assert (index < NR_DEFINED_FAULTS)
+    return &fault_matrix[ index ];
+}
+
 
 /* Public functions ---------------------------------------------------------*/
 
@@ -149,7 +174,7 @@ void Faultm_enable(faultm_ID_t faultm_ID, int enable_b)
 // assert (fault_ID < MAX)
 
 // use a pointer to cleanup (and optimize away the array-access?)
-    faultm_mat_t * pfaultm  = &fault_matrix[ faultm_ID ];
+    faultm_mat_t * pfaultm  = get_fault_entry( faultm_ID );
 
     pfaultm->enabled = enable_b;
 }
@@ -169,7 +194,7 @@ void Faultm_set(faultm_ID_t faultm_ID)
 // assert (fault_ID < MAX)
 
 // use a pointer to cleanup (and optimize away the array-access?)
-    faultm_mat_t * pfaultm  = &fault_matrix[ faultm_ID ];
+    faultm_mat_t * pfaultm  = get_fault_entry( faultm_ID );
 
 //    fault_status_reg_t  mask = (1 << faultm_ID); // maybe ... not necessary for now
     uint8_t  mask = (uint8_t) faultm_ID;
@@ -200,7 +225,7 @@ void Faultm_upd(faultm_ID_t faultm_ID, faultm_assert_t tcondition)
     fault_status_reg_t  mask = (fault_status_reg_t) faultm_ID;
 
 // use a pointer to cleanup (and optimize away the array-access?)
-    faultm_mat_t * pfaultm  = &fault_matrix[ faultm_ID ];
+    faultm_mat_t * pfaultm  = get_fault_entry( faultm_ID );
 
     if (tcondition)
     {
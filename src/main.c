@@ -15,6 +15,10 @@
 #include "mcu_stm8s.h"
 #include "bldc_sm.h"
 #include "per_task.h"
+#include "driver.h"
+#include "throttle.h"
+#include "thr_curve.h"
+#include "mdata.h"
 
 #ifndef SPI_CONTROLLER
 #include "spi_stm8s.h"
@@ -54,6 +58,17 @@ void main(int argc, char **argv)
 
   MCU_Init();
 
+#if !defined (S003_DEV)
+  Driver_ADC_calibrate(); // motor is stopped and interrupts not yet enabled
+#endif
+#if defined( HAS_SERVO_INPUT ) && !defined( DSHOT_ENABLED )
+  Throttle_Init();
+#endif
+  Thr_curve_Init();
+#if defined( OL_TUNE_ENABLED )
+  Mdata_Init();
+#endif
+
   BL_reset();
 
   printf("\n\rProgram Startup.......\n\r");
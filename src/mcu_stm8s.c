@@ -23,10 +23,25 @@
 
 /* Private defines -----------------------------------------------------------*/
 
+#if defined( TELEM_ENABLED )
+#ifdef STM8S105
+#define MCU_UART       UART2
+#define MCU_UART_TIEN  UART2_CR2_TIEN
+#else
+#define MCU_UART       UART1
+#define MCU_UART_TIEN  UART1_CR2_TIEN
+#endif
+#endif
+
 /* Public variables  ---------------------------------------------------------*/
 
 /* Private variables ---------------------------------------------------------*/
 
+#if defined( TELEM_ENABLED )
+static const uint8_t * Uart_tx_p;   // interrupt driven transmit
+static uint8_t Uart_tx_len;
+#endif
+
 /* Private function prototypes -----------------------------------------------*/
 
 /* Private functions ---------------------------------------------------------*/
@@ -66,6 +81,12 @@
   */
 PUTCHAR_PROTOTYPE
 {
+#if defined( TELEM_ENABLED )
+  // wait out a telemetry frame (not to be called with interrupts disabled)
+  while (0 != Uart_tx_len)
+  {
+  }
+#endif
   /* Write a character to the UART1 */
   UART2_SendData8(c);
   /* Loop until the end of transmission */
@@ -124,6 +145,12 @@ uint8_t SerialKeyPressed(char *key)
   */
 PUTCHAR_PROTOTYPE
 {
+#if defined( TELEM_ENABLED )
+  // wait out a telemetry frame (not to be called with interrupts disabled)
+  while (0 != Uart_tx_len)
+  {
+  }
+#endif
   /* Write a character to the UART1 */
   UART1_SendData8(c);
   /* Loop until the end of transmission */
@@ -210,6 +237,11 @@ static void GPIO_Config(void)
   GPIO_Init(SERVO_GPIO_PORT, (GPIO_Pin_TypeDef)SERVO_GPIO_PIN, GPIO_MODE_IN_PU_NO_IT);	
 #endif // SERVO
 
+#if defined( CURRENT_SENSE_ENABLED )
+// shunt amplifier (analog input): Input floating, no external interrupt
+  GPIO_Init(ISENSE_IN_PORT, (GPIO_Pin_TypeDef)ISENSE_IN_PIN, GPIO_MODE_IN_FL_NO_IT);
+#endif
+
 // Input pull-up, no external interrupt
   GPIO_Init(PH0_BEMF_IN_PORT, (GPIO_Pin_TypeDef)PH0_BEMF_IN_PIN, GPIO_MODE_IN_PU_NO_IT);
 
@@ -224,6 +256,51 @@ static void GPIO_Config(void)
 #endif
 }
 
+#if defined( TELEM_ENABLED )
+/**
+ * @brief Interrupt driven transmit of a buffer on the UART.
+ *
+ * @details The buffer must not be modified until sent (see MCU_uart_tx_busy).
+ * The transmit interrupt fires as soon as the data register is empty.
+ *
+ * @param p_buf  Data to send
+ * @param len    Length, bytes
+ */
+void MCU_uart_tx_start(const uint8_t * p_buf, uint8_t len)
+{
+  Uart_tx_p = p_buf;
+  Uart_tx_len = len;
+
+  MCU_UART->CR2 |= MCU_UART_TIEN;
+}
+
+/**
+ * @brief Accessor for the UART transmit state.
+ *
+ * @return  TRUE while an interrupt driven transmit is in progress
+ */
+uint8_t MCU_uart_tx_busy(void)
+{
+  return (uint8_t)( 0 != Uart_tx_len );
+}
+
+/**
+ * @brief Call from the UART transmit ISR (data register empty).
+ */
+void MCU_uart_on_tx(void)
+{
+  if (0 != Uart_tx_len)
+  {
+    MCU_UART->DR = *Uart_tx_p++;
+    Uart_tx_len -= 1;
+  }
+  if (0 == Uart_tx_len)
+  {
+    MCU_UART->CR2 &= (uint8_t)~MCU_UART_TIEN;
+  }
+}
+#endif // TELEM_ENABLED
+
 /**
  *  @brief Configure UART
  *  @details
@@ -276,6 +353,17 @@ static void UART_setup(void)
 #else
 #define ADC_DIVIDER ADC1_PRESSEL_FCPU_D2  // 4 ->  8/2 = 4
 #endif
+/*
+ * The scan sequence runs from channel 0 to the last channel needed - the shunt
+ * current sense channel is put at the end of the sequence so that it is
+ * converted in the same (PWM synchronized) scan as the phase voltage.
+ */
+#if defined( CURRENT_SENSE_ENABLED )
+#define ADC_SCAN_CHANNEL  ISENSE_ADC_CHANNEL // i.e. Ch 0 thru 4 are enabled
+#else
+#define ADC_SCAN_CHANNEL  ADC1_CHANNEL_3     // i.e. Ch 0, 1, 2, and 3 are enabled
+#endif
+
 /*
  * https://community.st.com/s/question/0D50X00009XkbA1SAJ/multichannel-adc
  */
@@ -286,7 +374,7 @@ static void ADC1_setup(void)
   ADC1_DeInit();
 
   ADC1_Init(ADC1_CONVERSIONMODE_SINGLE, // don't care, see ConversionConfig below ..
-            ADC1_CHANNEL_3,        // i.e. Ch 0, 1, 2, and 3 are enabled
+            ADC_SCAN_CHANNEL,
             ADC_DIVIDER,
             ADC1_EXTTRIG_TIM,      //  ADC1_EXTTRIG_GPIO ... not presently using any ex triggern
             DISABLE,               // ExtTriggerState
@@ -327,6 +415,15 @@ static void ADC1_setup(void)
  * channels 3 & 4 used to get leading and trailing edges of radio signal pulse.
  * THis is explained in STM8 Reference Manual RM0016.
 */
+// bidirectional DShot is inverted i.e. the bit starts with the falling edge
+#if defined( DSHOT_BIDIR )
+#define SERVO_ICPOLARITY_START  TIM2_ICPOLARITY_FALLING
+#define SERVO_ICPOLARITY_END    TIM2_ICPOLARITY_RISING
+#else
+#define SERVO_ICPOLARITY_START  TIM2_ICPOLARITY_RISING
+#define SERVO_ICPOLARITY_END    TIM2_ICPOLARITY_FALLING
+#endif
+
 static void Servo_CC_setup(void)
 {
   const uint16_t period = 0xFFFF;
@@ -335,32 +432,117 @@ static void Servo_CC_setup(void)
   TIM2_DeInit();
 
 // The counter clock frequency fCK_CNT is equal to fCK_PSC / 2(PSC[3:0])
+#if defined( DSHOT_ENABLED )
+  TIM2_TimeBaseInit( TIM2_PRESCALER_1, period); // DShot bit resolution
+#else
   TIM2_TimeBaseInit( TIM2_PRESCALER_32, period);
+#endif
 
   TIM2_ICInit(TIM2_CHANNEL_1,
-              TIM2_ICPOLARITY_RISING,
+              SERVO_ICPOLARITY_START,
               TIM2_ICSELECTION_DIRECTTI,
               TIM2_ICPSC_DIV1,
               ICFilter
              );
 
   TIM2_ICInit(TIM2_CHANNEL_2,
-              TIM2_ICPOLARITY_FALLING,
+              SERVO_ICPOLARITY_END,
               TIM2_ICSELECTION_INDIRECTTI,
               TIM2_ICPSC_DIV1, // TIM1_ICPrescaler
               ICFilter
              );
 
+#if defined( DSHOT_BIDIR )
+// compare channel 3 (no output) times the bits of the telemetry response
+  TIM2_OC3Init(TIM2_OCMODE_TIMING, TIM2_OUTPUTSTATE_DISABLE, 0, TIM2_OCPOLARITY_HIGH);
+#endif
+
 // timer update/ovrflow ISR not strictly needed but is handy to confirm timer rate
 //  TIM2_ITConfig(TIM2_IT_UPDATE, ENABLE);
 
-// enable capture channels
+// enable capture channels - DShot reads both captures on the falling edge
+#if !defined( DSHOT_ENABLED )
   TIM2_ITConfig(TIM2_IT_CC1, ENABLE);
+#endif
   TIM2_ITConfig(TIM2_IT_CC2, ENABLE);
 
   TIM2_Cmd(ENABLE);
 }
 
+/**
+ * @brief Set the servo capture timer resolution.
+ *
+ * @details The prescaler of 32 resolves the servo pulse over the full timer
+ * period, the prescaler of 1 (62.5 ns at 16 Mhz) is needed to resolve the
+ * short pulse protocols (OneShot, Multishot). Takes effect immediately.
+ *
+ * @param fast  TRUE for prescaler 1, FALSE for prescaler 32
+ */
+void MCU_set_capture_fast(uint8_t fast)
+{
+  TIM2_PrescalerConfig( (FALSE != fast) ? TIM2_PRESCALER_1 : TIM2_PRESCALER_32,
+                        TIM2_PSCRELOADMODE_IMMEDIATE );
+}
+
+#if defined( DSHOT_BIDIR )
+/**
+ * @brief Switch the servo pin between capture input and output.
+ *
+ * @details For the bidirectional DShot response: the pin is driven through
+ * the GPIO (idle high) with the capture interrupt disabled, and on return to
+ * input the captures of the response edges are discarded.
+ *
+ * @param output  TRUE for output
+ */
+void MCU_set_servo_output(uint8_t output)
+{
+  if (FALSE != output)
+  {
+    TIM2->IER &= (uint8_t)~TIM2_IER_CC2IE;
+    SERVO_GPIO_PORT->ODR |= SERVO_GPIO_PIN;
+    SERVO_GPIO_PORT->CR1 |= SERVO_GPIO_PIN; // push-pull
+    SERVO_GPIO_PORT->DDR |= SERVO_GPIO_PIN;
+  }
+  else
+  {
+    SERVO_GPIO_PORT->DDR &= (uint8_t)~SERVO_GPIO_PIN;
+    TIM2->SR1 = (uint8_t)~(TIM2_SR1_CC1IF | TIM2_SR1_CC2IF);
+    TIM2->SR2 = (uint8_t)~(TIM2_SR2_CC1OF | TIM2_SR2_CC2OF);
+    TIM2->IER |= TIM2_IER_CC2IE;
+  }
+}
+
+/**
+ * @brief Set the servo timer compare interrupt.
+ *
+ * @details For timing the bits of the bidirectional DShot response against the
+ * free-running capture timer. A compare time already passed is forced so the
+ * interrupt is late rather than lost (at the timer wrap).
+ *
+ * @param enable  TRUE to interrupt at the compare time, FALSE to disable
+ * @param tm      Compare time, capture timer counts
+ */
+void MCU_set_servo_compare(uint8_t enable, uint16_t tm)
+{
+  if (FALSE != enable)
+  {
+    TIM2->SR1 = (uint8_t)~TIM2_SR1_CC3IF;
+    TIM2->CCR3H = (uint8_t)(tm >> 8);
+    TIM2->CCR3L = (uint8_t)(tm);
+
+    if ( (int16_t)(MCU_SERVO_TIMER_CNT() - tm) >= 0 )
+    {
+      TIM2->EGR = TIM2_EGR_CC3G;
+    }
+    TIM2->IER |= TIM2_IER_CC3IE;
+  }
+  else
+  {
+    TIM2->IER &= (uint8_t)~TIM2_IER_CC3IE;
+  }
+}
+#endif
+
 #elif defined( S105_DISCOVERY )
 /*
  * STM8s105 Discovery TIM1 not available for PWM (unless touch pad disabled by
@@ -376,12 +558,25 @@ static void Servo_CC_setup(void)
  * channels 3 & 4 used to get leading and trailing edges of radio signal pulse.
  * THis is explained in STM8 Reference Manual RM0016.
 */
+// bidirectional DShot is inverted i.e. the bit starts with the falling edge
+#if defined( DSHOT_BIDIR )
+#define SERVO_ICPOLARITY_START  TIM1_ICPOLARITY_FALLING
+#define SERVO_ICPOLARITY_END    TIM1_ICPOLARITY_RISING
+#else
+#define SERVO_ICPOLARITY_START  TIM1_ICPOLARITY_RISING
+#define SERVO_ICPOLARITY_END    TIM1_ICPOLARITY_FALLING
+#endif
+
 static void Servo_CC_setup(void)
 {
 /*
  * counter clock frequency fCK_CNT is equal to fCK_PSC / (PSCR[15:0]+1)
  */
+#if defined( DSHOT_ENABLED )
+  const uint16_t T1_Prescaler = 1 - 1;  // DShot bit resolution
+#else
   const uint16_t T1_Prescaler = 32 - 1; // 1/16Mhz * 32 * 65536 = 0.131072 (about 131ms)
+#endif
 
   const uint16_t T1_Period = 0xFFFF;
   const uint8_t repetitionCounter = 1;
@@ -391,28 +586,166 @@ static void Servo_CC_setup(void)
   TIM1_TimeBaseInit( T1_Prescaler, TIM1_COUNTERMODE_UP, T1_Period, repetitionCounter );
 
   TIM1_ICInit(TIM1_CHANNEL_4,
-              TIM1_ICPOLARITY_RISING,
+              SERVO_ICPOLARITY_START,
               TIM1_ICSELECTION_DIRECTTI,
               TIM1_ICPSC_DIV1,
               ICFilter
              );
 
   TIM1_ICInit(TIM1_CHANNEL_3,
-              TIM1_ICPOLARITY_FALLING,
+              SERVO_ICPOLARITY_END,
               TIM1_ICSELECTION_INDIRECTTI,
               TIM1_ICPSC_DIV1,
               ICFilter
              );
 
+#if defined( DSHOT_BIDIR )
+// compare channel 1 (no output) times the bits of the telemetry response
+  TIM1_OC1Init(TIM1_OCMODE_TIMING, TIM1_OUTPUTSTATE_DISABLE, TIM1_OUTPUTNSTATE_DISABLE,
+               0, TIM1_OCPOLARITY_HIGH, TIM1_OCNPOLARITY_HIGH,
+               TIM1_OCIDLESTATE_RESET, TIM1_OCNIDLESTATE_RESET);
+#endif
+
 // timer update/ovrflow ISR not strictly needed but is handy to confirm timer rate
 //  TIM1_ITConfig(TIM1_IT_UPDATE, ENABLE); // be sure flag is cleared in ISR!
 
-// enable capture channels 3 & 4
+// enable capture channels 3 & 4 - DShot reads both captures on the falling edge
+#if !defined( DSHOT_ENABLED )
   TIM1_ITConfig(TIM1_IT_CC4, ENABLE);
+#endif
   TIM1_ITConfig(TIM1_IT_CC3, ENABLE);
 
   TIM1_Cmd(ENABLE);
 }
+
+/**
+ * @brief Set the servo capture timer resolution.
+ *
+ * @details See S105_DEV.
+ *
+ * @param fast  TRUE for prescaler 1, FALSE for prescaler 32
+ */
+void MCU_set_capture_fast(uint8_t fast)
+{
+  TIM1_PrescalerConfig( (FALSE != fast) ? (1 - 1) : (32 - 1),
+                        TIM1_PSCRELOADMODE_IMMEDIATE );
+}
+
+#if defined( DSHOT_BIDIR )
+/**
+ * @brief Switch the servo pin between capture input and output.
+ *
+ * @details See S105_DEV.
+ *
+ * @param output  TRUE for output
+ */
+void MCU_set_servo_output(uint8_t output)
+{
+  if (FALSE != output)
+  {
+    TIM1->IER &= (uint8_t)~TIM1_IER_CC3IE;
+    SERVO_GPIO_PORT->ODR |= SERVO_GPIO_PIN;
+    SERVO_GPIO_PORT->CR1 |= SERVO_GPIO_PIN; // push-pull
+    SERVO_GPIO_PORT->DDR |= SERVO_GPIO_PIN;
+  }
+  else
+  {
+    SERVO_GPIO_PORT->DDR &= (uint8_t)~SERVO_GPIO_PIN;
+    TIM1->SR1 = (uint8_t)~(TIM1_SR1_CC3IF | TIM1_SR1_CC4IF);
+    TIM1->SR2 = (uint8_t)~(TIM1_SR2_CC3OF | TIM1_SR2_CC4OF);
+    TIM1->IER |= TIM1_IER_CC3IE;
+  }
+}
+
+/**
+ * @brief Set the servo timer compare interrupt.
+ *
+ * @details See S105_DEV.
+ *
+ * @param enable  TRUE to interrupt at the compare time, FALSE to disable
+ * @param tm      Compare time, capture timer counts
+ */
+void MCU_set_servo_compare(uint8_t enable, uint16_t tm)
+{
+  if (FALSE != enable)
+  {
+    TIM1->SR1 = (uint8_t)~TIM1_SR1_CC1IF;
+    TIM1->CCR1H = (uint8_t)(tm >> 8);
+    TIM1->CCR1L = (uint8_t)(tm);
+
+    if ( (int16_t)(MCU_SERVO_TIMER_CNT() - tm) >= 0 )
+    {
+      TIM1->EGR = TIM1_EGR_CC1G;
+    }
+    TIM1->IER |= TIM1_IER_CC1IE;
+  }
+  else
+  {
+    TIM1->IER &= (uint8_t)~TIM1_IER_CC1IE;
+  }
+}
+#endif
+
+#elif defined( S003_DEV )
+/*
+ * No timer is available for input capture on the S003, so the servo pulse
+ * edges are timestamped in the EXTI ISR against the commutation timer (TIM1,
+ * 8 counts per us), see Driver_on_servo_edge(). The timestamp is scaled to the
+ * units of the S105 capture timer so the throttle decoding is the same.
+ */
+#ifdef CLOCK_16
+#define SERVO_TM_SLOW_SH  4  // >> 0.5 count per us i.e. prescaler 32
+#define SERVO_TM_FAST_SH  1  // << 16 counts per us i.e. prescaler 1
+#else
+#define SERVO_TM_SLOW_SH  5
+#define SERVO_TM_FAST_SH  0
+#endif
+
+static uint8_t Servo_tm_fast;
+
+/**
+ * @brief Setup external interrupt for servo signal pulse input.
+ *
+ * @details Interrupt on both edges. The EXTI sensitivity is only writable with
+ * interrupts disabled (i.e. at init). The SPL EXTI driver is not built so the
+ * register is written directly.
+ */
+static void Servo_CC_setup(void)
+{
+  EXTI->CR1 |= EXTI_CR1_PAIS; // port A rising and falling edge
+
+  GPIO_Init(SERVO_GPIO_PORT, (GPIO_Pin_TypeDef)SERVO_GPIO_PIN, GPIO_MODE_IN_PU_IT);
+}
+
+/**
+ * @brief Set the servo capture timer resolution.
+ *
+ * @details See S105_DEV. Only the scaling of the timestamp is changed, the
+ * resolution is limited by the interrupt latency which makes the shortest
+ * protocols (Multishot) not usable.
+ *
+ * @param fast  TRUE for prescaler 1, FALSE for prescaler 32
+ */
+void MCU_set_capture_fast(uint8_t fast)
+{
+  Servo_tm_fast = fast;
+}
+
+/**
+ * @brief Scale a commutation timer timestamp to the servo capture timebase.
+ *
+ * @param comm_tm  Timestamp, commutation timer counts
+ *
+ * @return  Timestamp as servo capture timer counts (wraps at 16-bits)
+ */
+uint16_t MCU_servo_tm(uint32_t comm_tm)
+{
+  if (FALSE != Servo_tm_fast)
+  {
+    return (uint16_t)( comm_tm << SERVO_TM_FAST_SH );
+  }
+  return (uint16_t)( comm_tm >> SERVO_TM_SLOW_SH );
+}
 #endif // S105 DISCOVERY
 #endif // HAS_SERVO_INP
 
@@ -452,6 +785,30 @@ void MCU_set_comm_timer(uint16_t period)
   TIM3->CR1 |= TIM3_CR1_CEN; // Enable TIM3
 }
 
+/**
+ * @brief Phases the commutation timer.
+ * Sets the period immediately, i.e. without waiting for the update event to
+ * reload it, and presets the count, e.g. to synchronize to a spinning rotor.
+ * @param  period  Value written to auto-reload register
+ * @param  count   Time already elapsed into the period
+ */
+void MCU_phase_comm_timer(uint16_t period, uint16_t count)
+{
+  TIM3->CR1 &= (uint8_t)(~TIM3_CR1_CEN);
+
+  TIM3->ARRH = (uint8_t)(period >> 8);   // be sure to set byte ARRH first, see data sheet
+  TIM3->ARRL = (uint8_t)(period & 0xff);
+
+  TIM3->CR1 |= TIM3_CR1_URS;  // UG reloads the period without an update interrupt
+  TIM3->EGR = TIM3_EGR_UG;
+
+  TIM3->CNTRH = (uint8_t)(count >> 8);   // be sure to set byte CNTRH first
+  TIM3->CNTRL = (uint8_t)(count & 0xff);
+
+  TIM3->CR1 = TIM3_CR1_ARPE; // auto (re)loading the count
+  TIM3->CR1 |= TIM3_CR1_CEN;
+}
+
 #elif defined( S003_DEV ) // uses TIM1 which is not preferred
 
 /**
@@ -480,6 +837,30 @@ void MCU_set_comm_timer(uint16_t period)
   TIM1->CR1 = TIM1_CR1_ARPE; // auto (re)loading the count
   TIM1->CR1 |= TIM1_CR1_CEN; // Enable timer
 }
+
+/**
+ * @brief Phases the commutation timer.
+ * Sets the period immediately, i.e. without waiting for the update event to
+ * reload it, and presets the count, e.g. to synchronize to a spinning rotor.
+ * @param  period  Value written to auto-reload register
+ * @param  count   Time already elapsed into the period
+ */
+void MCU_phase_comm_timer(uint16_t period, uint16_t count)
+{
+  TIM1->CR1 &= (uint8_t)(~TIM1_CR1_CEN);
+
+  TIM1->ARRH = (uint8_t)(period >> 8);   // be sure to set byte ARRH first, see data sheet
+  TIM1->ARRL = (uint8_t)(period & 0xff);
+
+  TIM1->CR1 |= TIM1_CR1_URS;  // UG reloads the period without an update interrupt
+  TIM1->EGR = TIM1_EGR_UG;
+
+  TIM1->CNTRH = (uint8_t)(count >> 8);   // be sure to set byte CNTRH first
+  TIM1->CNTRL = (uint8_t)(count & 0xff);
+
+  TIM1->CR1 = TIM1_CR1_ARPE; // auto (re)loading the count
+  TIM1->CR1 |= TIM1_CR1_CEN;
+}
 #endif
 
 /*
@@ -578,6 +959,40 @@ void SPI_setup(void)
 
 
 
+#if defined( DSHOT_BIDIR )
+/*
+ * Interrupt priority: the motor ISRs (PWM timer, commutation timer, ADC) are
+ * lowered from the reset level (3) to level 2, so the servo timer ISR preempts
+ * them and the bits of the DShot telemetry response are timed to within the
+ * ISR latency. The control tick (TIM4) is lowered with them: it sets the
+ * commutation timer, step and state that the commutation and ADC ISRs use, so
+ * none of the motor ISRs can preempt another as at the reset level. The
+ * priority registers may only be written with interrupts disabled i.e. at init.
+ */
+static void Irq_priority_setup(void)
+{
+#if defined( S105_DEV )
+  static const uint8_t irq_tb[] =
+  {
+    ITC_IRQ_TIM1_OVF, ITC_IRQ_TIM3_OVF, ITC_IRQ_ADC1, ITC_IRQ_TIM4_OVF
+  };
+#else
+  static const uint8_t irq_tb[] =
+  {
+    ITC_IRQ_TIM2_OVF, ITC_IRQ_TIM3_OVF, ITC_IRQ_ADC1, ITC_IRQ_TIM4_OVF
+  };
+#endif
+  volatile uint8_t * p_spr = &ITC->ISPR1;
+  uint8_t n;
+
+  for (n = 0; n < sizeof(irq_tb); n++)
+  {
+    // 2 bits per IRQ, level 2 is 00
+    p_spr[ irq_tb[n] / 4 ] &= (uint8_t)~( 3 << ( (irq_tb[n] % 4) * 2 ) );
+  }
+}
+#endif
+
 /**
  * @brief  Initialize MCU and peripheral modules
  * Configures clocks, GPIO, UART, ADC, timers, PWM.
@@ -600,6 +1015,10 @@ void MCU_Init(void)
 #if defined( SPI_ENABLED )
   SPI_setup();
 #endif
+
+#if defined( DSHOT_BIDIR )
+  Irq_priority_setup();
+#endif
 }
 
 /**@}*/ // defgroup
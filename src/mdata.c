@@ -10,15 +10,26 @@
 /**
  * \defgroup mdata Motor Model Data
   * @brief  Motor data table lookup
+ *
+ * @details The open-loop timing table in ROM is characterized for one motor.
+ * With OL_TUNE_ENABLED, a motor specific table measured by the tuning sweep
+ * (see BLDC_sm.c) is stored in the data EEPROM and is used in place of the
+ * ROM table. The tuned table is OL_TUNE_KNOTS commutation periods evenly
+ * spaced over the duty-cycle range of the sweep. Outside of that range the
+ * ROM table is scaled to meet the tuned table at the end knots. The ROM
+ * table is the fallback if no tuned table is stored (or the record is bad).
  * @{
  */
 
 /* Includes ------------------------------------------------------------------*/
 
 #include "system.h" // dependency of motor data on cpu clock specific timer rate
+#include "mdata.h"
+#include "eeprom.h"
 
 /*
- * The table is indexed by PWM duty cycle counts (i.e. [0:1:250)
+ * The table is indexed by PWM duty cycle counts (i.e. [0:1:250) i.e. the
+ * integer part of the duty-cycle command (DC_SH fractional bits)
  * The function generates the data in Scilab and imported from csv:
  *
  *   y =  ( 4000 * EXP( -t/25 ) ) + 150
@@ -113,23 +124,311 @@ static const uint16_t OL_Timing[ /* TABLE_SIZE */ ] =
 
 #define OL_TIMING_TBL_SIZE    ( sizeof(OL_Timing) / sizeof(uint16_t) )
 
+#if defined( OL_TUNE_ENABLED )
+// scale of the ROM table outside of the tuned range, fixed-point
+#define OL_SCALE_SH           8
+#define OL_SCALE_MIN          ( (1 << OL_SCALE_SH) / 4 )
+#define OL_SCALE_MAX          ( (1 << OL_SCALE_SH) * 4 )
+
+static uint16_t OL_tuned[ OL_TUNE_KNOTS ];
+
+static uint16_t OL_scale_lo;  // ROM table below the tuned range
+static uint16_t OL_scale_hi;  // ROM table above the tuned range
+
+static uint8_t OL_tuned_ok;
+#endif
+
+
+/*
+ * ROM table lookup, linear interpolation between the table entries on the
+ * fractional part of the duty-cycle. Above the end of the table the timing is
+ * held at the last entry (the fastest characterized).
+ */
+static uint16_t rom_timing(uint16_t dc)
+{
+    uint16_t index = dc >> DC_SH;
+    uint16_t frac = dc & ( (1 << DC_SH) - 1 );
+    uint16_t t0;
+    uint16_t t1;
+
+    if ( index < (OL_TIMING_TBL_SIZE - 1) )
+    {
+        t0 = OL_Timing[ index ];
+        t1 = OL_Timing[ index + 1 ];
+
+        if (t0 > t1)
+        {
+            t0 -= (uint16_t)( ( (uint32_t)(t0 - t1) * frac ) >> DC_SH );
+        }
+        else
+        {
+            t0 += (uint16_t)( ( (uint32_t)(t1 - t0) * frac ) >> DC_SH );
+        }
+        return t0 * CTIME_SCALAR;
+    }
+    return OL_Timing[ OL_TIMING_TBL_SIZE - 1 ] * CTIME_SCALAR;
+}
+
+#if defined( OL_TUNE_ENABLED )
+/*
+ * Scale factor of the ROM table to meet the tuned table at a knot, 0 if not
+ * plausible
+ */
+static uint16_t rom_scale(uint16_t dc, uint16_t tm)
+{
+    uint16_t rom_tm = rom_timing(dc);
+    uint32_t scale;
+
+    scale = ( (uint32_t)tm << OL_SCALE_SH ) / rom_tm;
+
+    return (scale < OL_SCALE_MIN || scale > OL_SCALE_MAX) ? 0 : (uint16_t)scale;
+}
+
+/*
+ * Apply a tuned table: the timing is non-increasing with the duty-cycle, and
+ * the ROM table can be scaled to meet it at the end knots
+ */
+static uint8_t set_tuned(const uint16_t * p_knots)
+{
+    uint16_t lo;
+    uint16_t hi;
+    uint8_t n;
+
+    for (n = 0; n < OL_TUNE_KNOTS; n++)
+    {
+        if (0 == p_knots[n]  ||  ( n > 0  &&  p_knots[n] > p_knots[n - 1] ))
+        {
+            return FALSE;
+        }
+    }
+
+    lo = rom_scale(OL_TUNE_DC_MIN, p_knots[0]);
+    hi = rom_scale(OL_TUNE_DC_MAX, p_knots[OL_TUNE_KNOTS - 1]);
+
+    if (0 == lo || 0 == hi)
+    {
+        return FALSE;
+    }
+
+    OL_tuned_ok = FALSE;
+
+    for (n = 0; n < OL_TUNE_KNOTS; n++)
+    {
+        OL_tuned[n] = p_knots[n];
+    }
+    OL_scale_lo = lo;
+    OL_scale_hi = hi;
+
+    OL_tuned_ok = TRUE;
+
+    return TRUE;
+}
+
+/*
+ * Tuned table lookup
+ */
+static uint16_t tuned_timing(uint16_t dc)
+{
+    uint16_t seg;
+    uint16_t frac;
+    uint16_t scale;
+    uint32_t u32;
+
+    if (dc >= OL_TUNE_DC_MIN  &&  dc <= OL_TUNE_DC_MAX)
+    {
+        seg = (dc - OL_TUNE_DC_MIN) / OL_TUNE_DC_STEP;
+        frac = (dc - OL_TUNE_DC_MIN) - (seg * OL_TUNE_DC_STEP);
+
+        if (seg >= (OL_TUNE_KNOTS - 1))
+        {
+            return OL_tuned[ OL_TUNE_KNOTS - 1 ];
+        }
+        // the table is non-increasing
+        return OL_tuned[seg] -
+               (uint16_t)( ( (uint32_t)(OL_tuned[seg] - OL_tuned[seg + 1]) * frac ) /
+                           OL_TUNE_DC_STEP );
+    }
+
+    u32 = rom_timing(dc);
+
+    scale = (dc < OL_TUNE_DC_MIN) ? OL_scale_lo : OL_scale_hi;
+    u32 = (u32 * scale) >> OL_SCALE_SH;
+
+    return (u32 < U16_MAX) ? (uint16_t)u32 : (U16_MAX - 1);
+}
+#endif // OL_TUNE_ENABLED
+
 
 /**
  * @brief Table lookup for open-loop commutation timing
  *
- * @param index  Index into the table - motor speed i.e. PWM duty-cycle
+ * @details Linear interpolation between the table entries on the fractional
+ *  part of the duty-cycle, the tuned table if there is one.
+ *
+ * @param dc  Motor speed i.e. PWM duty-cycle command
+ *
+ * @return LUT value @ dc
+ */
+uint16_t Get_OL_Timing(uint16_t dc)
+{
+#if defined( OL_TUNE_ENABLED )
+    if (FALSE != OL_tuned_ok)
+    {
+        return tuned_timing(dc);
+    }
+#endif
+    return rom_timing(dc);
+}
+
+/**
+ * @brief Inverse table lookup for open-loop commutation timing
+ *
+ * @details Binary search of the duty-cycle command (the table timing is
+ *  decreasing with the duty-cycle) so that the interpolation is exactly the
+ *  inverse of Get_OL_Timing().
+ *
+ * @param ctm  Commutation period
+ *
+ * @return Lowest duty-cycle command with the table timing at or below ctm
+ */
+uint16_t Get_OL_Dutycycle(uint16_t ctm)
+{
+    uint16_t lo = 0;
+    uint16_t hi = (OL_TIMING_TBL_SIZE - 1) << DC_SH;
+    uint16_t mid;
+
+    if (hi > DC_100PCNT)
+    {
+        hi = DC_100PCNT;
+    }
+
+    while (lo < hi)
+    {
+        mid = lo + ( (hi - lo) >> 1 );
+
+        if (Get_OL_Timing(mid) > ctm)
+        {
+            lo = mid + 1;
+        }
+        else
+        {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+#if defined( OL_TUNE_ENABLED )
+/**
+ * @brief Load the tuned open-loop timing table.
+ *
+ * @details Called once at startup, the ROM table is used if none is stored.
+ */
+void Mdata_Init(void)
+{
+    uint16_t knots[ OL_TUNE_KNOTS ];
+
+    if (FALSE != Eeprom_Load(EE_OFFS_OL_TABLE, knots, sizeof(knots)))
+    {
+        (void)set_tuned(knots);
+    }
+}
+
+/**
+ * @brief Apply a tuned open-loop timing table.
+ *
+ * @details Called from the control task at the end of the tuning sweep. The
+ *  table is the least-squares non-increasing fit of the measured periods
+ *  (pool adjacent violators: a run of knots that is out of order is replaced
+ *  by its average), and applies immediately (it is not saved, see Mdata_Save).
  *
- * @return LUT value @ index
- * @retval -1 error
+ * @param p_knots  OL_TUNE_KNOTS commutation periods measured at OL_TUNE_DC(n)
+ *
+ * @return  TRUE if the table is plausible and applied
  */
-uint16_t Get_OL_Timing(uint16_t index)
+uint8_t Mdata_Set(const uint16_t * p_knots)
 {
-    // assert index < OL_TIMING_TBL_SIZE
-    if ( index < OL_TIMING_TBL_SIZE )
+    uint32_t sum[ OL_TUNE_KNOTS ];
+    uint8_t cnt[ OL_TUNE_KNOTS ];
+    uint16_t fit[ OL_TUNE_KNOTS ];
+    uint8_t nb = 0;
+    uint8_t n;
+    uint8_t b;
+
+    for (n = 0; n < OL_TUNE_KNOTS; n++)
     {
-        return OL_Timing[ index ] * CTIME_SCALAR;
+        sum[nb] = p_knots[n];
+        cnt[nb] = 1;
+        nb += 1;
+
+        // pool while the average of the last block is above the one preceding
+        while ( nb > 1  &&
+                ( sum[nb - 1] * cnt[nb - 2] ) > ( sum[nb - 2] * cnt[nb - 1] ) )
+        {
+            sum[nb - 2] += sum[nb - 1];
+            cnt[nb - 2] += cnt[nb - 1];
+            nb -= 1;
+        }
     }
-    return (U16_MAX); // error
+
+    for (b = 0, n = 0; b < nb; b++)
+    {
+        uint8_t k;
+
+        for (k = 0; k < cnt[b]; k++)
+        {
+            fit[n++] = (uint16_t)( sum[b] / cnt[b] );
+        }
+    }
+    return set_tuned(fit);
+}
+
+/**
+ * @brief Save the tuned open-loop timing table.
+ *
+ * @details Called from the background task with the motor stopped (blocks for
+ *  a few ms per byte).
+ *
+ * @return  TRUE if saved
+ */
+uint8_t Mdata_Save(void)
+{
+    return (uint8_t)( FALSE != OL_tuned_ok  &&
+                      FALSE != Eeprom_Save(EE_OFFS_OL_TABLE, OL_tuned, sizeof(OL_tuned)) );
+}
+
+/**
+ * @brief Revert to the ROM open-loop timing table.
+ *
+ * @details Called from the background task with the motor stopped, the stored
+ *  table is cleared (an all-0 record is not plausible).
+ *
+ * @return  TRUE if cleared
+ */
+uint8_t Mdata_Clear(void)
+{
+    uint8_t n;
+
+    OL_tuned_ok = FALSE;
+
+    for (n = 0; n < OL_TUNE_KNOTS; n++)
+    {
+        OL_tuned[n] = 0;
+    }
+    return Eeprom_Save(EE_OFFS_OL_TABLE, OL_tuned, sizeof(OL_tuned));
+}
+
+/**
+ * @brief Accessor for a knot of the tuned open-loop timing table.
+ *
+ * @param knot  Index [0:OL_TUNE_KNOTS)
+ *
+ * @return  Commutation period, 0 if the ROM table is used
+ */
+uint16_t Mdata_Get(uint8_t knot)
+{
+    return (FALSE != OL_tuned_ok) ? OL_tuned[knot] : 0;
 }
+#endif // OL_TUNE_ENABLED
 
 /**@}*/ // defgroup
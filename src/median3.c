@@ -0,0 +1,71 @@
+/**
+  ******************************************************************************
+  * @file median3.c
+  * @brief Median-of-3 filter
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  */
+/**
+ * \defgroup median3  Median-of-3
+ * @brief Median-of-3 filter
+ *
+ * @details Median of the new sample and the previous 2 samples, using only
+ * min/max (compiles to compares and loads, no sorting):
+ *   median(a, b, c) = max( min(a, b), min( max(a, b), c ) )
+ * A single outlier is rejected outright, and a genuine step in the signal is
+ * passed through with 1 sample delay.
+ * @{
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+#include "median3.h"
+
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Reset the filter history.
+ *
+ * @details The history is seeded from the first sample following, so the
+ * output follows from the first sample rather than from 0.
+ *
+ * @param p_hist  Filter history
+ */
+void Median3_Reset(median3_t * p_hist)
+{
+  p_hist->seeded = FALSE;
+}
+
+/**
+ * @brief Filter a sample.
+ *
+ * @param p_hist  Filter history
+ * @param sample  New sample
+ * @return  Median of the new sample and the previous 2 samples
+ */
+uint16_t Median3(median3_t * p_hist, uint16_t sample)
+{
+  uint16_t lo;
+  uint16_t hi;
+
+  if (FALSE == p_hist->seeded)
+  {
+    p_hist->s0 = sample;
+    p_hist->s1 = sample;
+    p_hist->seeded = TRUE;
+  }
+
+  lo = MIN16(p_hist->s0, p_hist->s1);
+  hi = MAX16(p_hist->s0, p_hist->s1);
+
+  p_hist->s0 = p_hist->s1;
+  p_hist->s1 = sample;
+
+  hi = MIN16(hi, sample);
+  return MAX16(lo, hi);
+}
+
+/**@}*/ // defgroup
@@ -24,6 +24,12 @@
 #include "faultm.h"
 #include "driver.h"
 #include "spi_stm8s.h"
+#include "scope.h"
+#include "dshot.h"
+#include "throttle.h"
+#include "telem.h"
+#include "thr_curve.h"
+#include "mdata.h"
 
 
 /* Private defines -----------------------------------------------------------*/
@@ -43,6 +49,16 @@
 
 #define LOW_SPEED_THR       20     // turn off before low-speed low-voltage occurs
 
+// over-current fault threshold 15A (ADC counts above zero-current, ~20.5 counts/A)
+#define ISENSE_FAULT_THR    0x0133
+
+// hardware limit (BKIN) cutting more PWM cycles than this per background task
+// period is a persistent over-current condition
+#define ISENSE_BRK_THR      0x40
+
+// throttle curve knots are entered/printed in permille of full throttle
+#define CURVE_PM_MAX        1000
+
 
 /* Private function prototypes -----------------------------------------------*/
 
@@ -52,6 +68,20 @@ static void spd_plus(void);
 static void spd_minus(void);
 static void m_stop(void);
 static void set_ctlm(void);
+#if defined( SCOPE_ENABLED )
+static void scope_fault(void);
+static void scope_step(void);
+static void scope_error(void);
+#endif
+#if defined( HAS_SERVO_INPUT )
+static void latency(void);
+#endif
+static void curve(void);
+static void st_times(void);
+#if defined( OL_TUNE_ENABLED )
+static void ol_tune(void);
+static void ol_rom(void);
+#endif
 
 
 /* Public variables  ---------------------------------------------------------*/
@@ -73,6 +103,20 @@ enum
 #endif
   SPD_PLUS   = '.', //'>',
   SPD_MINUS  = ',', //'<',
+#if defined( SCOPE_ENABLED )
+  SCOPE_FAULT = 'f',
+  SCOPE_STEP  = 's',
+  SCOPE_ERROR = 'e',
+#endif
+#if defined( HAS_SERVO_INPUT )
+  LATENCY    = 'l',
+#endif
+  CURVE      = 'c',
+  ST_TIMES   = 'm',
+#if defined( OL_TUNE_ENABLED )
+  OL_TUNE    = 'a',
+  OL_ROM     = 'A',
+#endif
   M_STOP     = ' '  // one space character
 };
 
@@ -98,13 +142,28 @@ static uint16_t UI_pulse_perd;
 static uint16_t UI_pulse_dur;
 
 static uint16_t Analog_slider; // input var for 10-bit ADC conversions
-static uint8_t UI_Speed;       // speed setting in 8-bits
+static uint16_t UI_Speed;      // speed setting, duty-cycle command
 static int8_t Digital_trim_switch; // trim switches have + and - extents
 
 static uint8_t TaskRdy;  // flag for timer interrupt for BG task timing
 
 static uint8_t Log_Level;
 
+#if defined( HAS_SERVO_INPUT )
+static uint8_t Lat_report;     // print the throttle latency
+#endif
+static uint8_t Curve_edit;     // print the throttle curve and open the input line
+static uint8_t Curve_line;     // the throttle curve input line has the terminal
+static uint16_t Curve_knots[ THR_CURVE_KNOTS ]; // knots of the input line
+static uint16_t Curve_pm;      // number being read, permille
+static uint8_t Curve_digits;   // a number is being read
+static uint8_t Curve_n;        // numbers read
+static uint8_t St_report;      // print the startup phase durations
+#if defined( OL_TUNE_ENABLED )
+static uint8_t Tune_req;       // arm the open-loop table tuning
+static uint8_t Rom_req;        // revert to the ROM open-loop table
+#endif
+
 static  uint16_t Vsystem; // persistent for averaging
 
 static const ui_key_handler_t ui_keyhandlers_tb[] =
@@ -113,7 +172,21 @@ static const ui_key_handler_t ui_keyhandlers_tb[] =
 //  {COMM_MINUS, comm_minus},
   {SPD_PLUS,   spd_plus},
   {SPD_MINUS,  spd_minus},
-  {M_STOP,     m_stop}
+  {M_STOP,     m_stop},
+#if defined( SCOPE_ENABLED )
+  {SCOPE_FAULT, scope_fault},
+  {SCOPE_STEP,  scope_step},
+  {SCOPE_ERROR, scope_error},
+#endif
+#if defined( HAS_SERVO_INPUT )
+  {LATENCY,    latency},
+#endif
+  {CURVE,      curve},
+  {ST_TIMES,   st_times},
+#if defined( OL_TUNE_ENABLED )
+  {OL_TUNE,    ol_tune},
+  {OL_ROM,     ol_rom},
+#endif
 };
 
 // macros to help make the LUT slightly more encapsulateed
@@ -156,8 +229,9 @@ static void dbg_println(int zrof)
   Line_Count  += 1;;
 
   printf(
-    "{%04X) UI=%X CT=%04X DC=%04X Vs=%04X SF=%X RC=%04X ERR=%04X \r\n",
+    "{%04X) ST=%X UI=%X CT=%04X DC=%04X Vs=%04X SF=%X RC=%04X ERR=%04X \r\n",
     Line_Count,
+    (int)BL_get_sm_state(),
     uispd,
     get_commutation_period(),
     BLDC_PWMDC_Get(),
@@ -168,27 +242,22 @@ static void dbg_println(int zrof)
   );
 }
 
-//$0768 - $044A  = $031E
-#define RF_PCNT_ZERO   0x044A
-#define RF_PCNT_100    0x0768
-#define RF_RANGE       (RF_PCNT_100 - RF_PCNT_ZERO) // 0x031E // hardcode range of pulse
-#define RF_NORDO_THR   0x3000 // arbitrary 0x2BB0 -> 0x55C0 when receiving
 /*
  * Service the slider and trim inputs for speed setting.
- * The UI Speed value is a uint8 and represents the adjustment range of e.g. a
- * proportional RC radio control signal (eventually), and alternatively the
- * slider-pot (the developer h/w) - the UI Speed is passed to PWMDC_set() where
- * is expected to be rescaled to suite the range/precision required for PWM timer.
- *
- * TODO: rate limit of speed input!
+ * The UI Speed value is the 16-bit duty-cycle command (see DC_100PCNT) and
+ * represents the adjustment range of e.g. a proportional RC radio control
+ * signal, and alternatively the slider-pot (the developer h/w) - the UI Speed
+ * is passed to PWMDC_set() and is only scaled to the PWM timer resolution at
+ * the compare register. Each trim step is 1 count of the 8kHz PWM (0.4%).
+ * The speed input is rate limited at the control rate (see BLDC_Update).
  */
 static void set_ui_speed(void)
 {
-  uint16_t tmp_u16;
-  int16_t tmp_sint16;
+  int32_t tmp_sint32;
   uint16_t adc_tmp16 = ADC1_GetBufferValue( ADC1_CHANNEL_3 ); // ISR safe ... hmmmm
 #ifdef ANLG_SLIDER
-  Analog_slider = adc_tmp16 / 4; // [ 0: 1023 ] -> [ 0: 255 ]
+  // [ 0: 1023 ] -> [ 0: DC_100PCNT )
+  Analog_slider = (uint16_t)( ( (uint32_t)adc_tmp16 * DC_100PCNT ) >> 10 );
 #else
   Analog_slider = 0;
 #endif
@@ -196,34 +265,37 @@ static void set_ui_speed(void)
   UI_pulse_perd = Driver_get_pulse_perd();
 
   UI_pulse_dur = Driver_get_pulse_dur();
-// lose 1 bit of precision here ....
-  tmp_u16 = ( UI_pulse_dur - RF_PCNT_ZERO ) >> 1;  //  /2
 
-//   scale factors ...     ( 1/2   +   1/2 )  /     (1/4)
-  UI_pulse_dc = (PWM_100PCNT>>1) * tmp_u16 / (RF_RANGE>>2);
+#if defined( HAS_SERVO_INPUT )
+  // throttle is normalized for the detected protocol (servo, OneShot etc.)
+  UI_pulse_dc = Throttle_Get();
+#endif
 
-// if RF pulse qualified, then use it - needs more thought
-  if (UI_pulse_perd > RF_NORDO_THR)
+#if defined( HAS_SERVO_INPUT )
+  // once a throttle signal is qualified it has control (including failsafe,
+  // i.e. the slider does not take over again on loss of signal)
+  if (THR_SIG_NONE != Throttle_Get_signal())
   {
-//	Analog_slider = UI_pulse_dc;
+    Analog_slider = UI_pulse_dc;
   }
+#endif
 
 
 // careful with expression containing signed int ... UI Speed is defaulted
-// to 0 and only assign from temp sum if positive and clip to INT8 MAX S8.
+// to 0 and only assign from temp sum if positive and clip to 100%.
   UI_Speed = 0;
 
-  tmp_sint16 = Digital_trim_switch;
-  tmp_sint16 += Analog_slider; // comment out to disable analog slider (throttle hi protection is WIPO)
+  tmp_sint32 = (int32_t)Digital_trim_switch << DC_SH;
+  tmp_sint32 += Analog_slider; // comment out to disable analog slider (throttle hi protection is WIPO)
 
-  if (tmp_sint16 > 0)
+  if (tmp_sint32 > 0)
   {
-    // clip to INT8 MAX S8
-    if (tmp_sint16 > U8_MAX)
+    // clip to 100%
+    if (tmp_sint32 > DC_100PCNT)
     {
-      tmp_sint16 = U8_MAX;
+      tmp_sint32 = DC_100PCNT;
     }
-    UI_Speed = (uint8_t)tmp_sint16;
+    UI_Speed = (uint16_t)tmp_sint32;
   }
 }
 
@@ -288,6 +360,209 @@ static void spd_minus(void)
   }
 }
 
+#if defined( SCOPE_ENABLED )
+// arm the back-EMF capture, streamed to terminal when complete
+static void scope_fault(void)
+{
+  Scope_Arm(SCOPE_TRIG_FAULT);
+}
+
+static void scope_step(void)
+{
+  Scope_Arm(SCOPE_TRIG_STEP);
+}
+
+static void scope_error(void)
+{
+  Scope_Arm(SCOPE_TRIG_ERROR);
+}
+#endif
+
+#if defined( HAS_SERVO_INPUT )
+// report the throttle latency (printed outside of the CS)
+static void latency(void)
+{
+  Lat_report = TRUE;
+}
+#endif
+
+// print/load the throttle curve (terminal input outside of the CS)
+static void curve(void)
+{
+  Curve_edit = TRUE;
+}
+
+// report the startup phase durations (printed outside of the CS)
+static void st_times(void)
+{
+  St_report = TRUE;
+}
+
+#if defined( OL_TUNE_ENABLED )
+// arm the open-loop table tuning (EEPROM access outside of the CS)
+static void ol_tune(void)
+{
+  Tune_req = TRUE;
+}
+
+// revert to the ROM open-loop table (EEPROM access outside of the CS)
+static void ol_rom(void)
+{
+  Rom_req = TRUE;
+}
+
+/*
+ * Prints the tuned open-loop table (commutation periods at the knots), or ROM
+ */
+static void ol_table_print(void)
+{
+  uint8_t n;
+
+  printf("OL TABLE");
+  if (0 == Mdata_Get(0))
+  {
+    printf(" ROM");
+  }
+  else
+  {
+    for (n = 0; n < OL_TUNE_KNOTS; n++)
+    {
+      printf(" %u", Mdata_Get(n));
+    }
+  }
+  printf("\r\n");
+}
+
+/*
+ * Open-loop table tuning requests and result, with the motor stopped (the
+ * tuned table is saved to the EEPROM once the motor is stopped after the sweep)
+ */
+static void ol_tune_task(BL_RUNSTATE_t bl_state)
+{
+  BL_TUNE_t status = BL_Tune_status();
+
+  if (FALSE != Tune_req)
+  {
+    Tune_req = FALSE;
+    ol_table_print();
+
+    if (BL_NOT_RUNNING == bl_state  &&  BL_TUNE_SWEEP != status)
+    {
+      BL_Tune_arm();
+      printf("OL TUNE ARMED\r\n");
+    }
+  }
+  if (FALSE != Rom_req)
+  {
+    Rom_req = FALSE;
+
+    if (BL_NOT_RUNNING == bl_state  &&  BL_TUNE_SWEEP != status)
+    {
+      BL_Tune_ack();
+      printf( (FALSE != Mdata_Clear()) ? "OL TABLE ROM\r\n" : "OL TABLE ERR\r\n" );
+    }
+  }
+
+  if (BL_NOT_RUNNING == bl_state)
+  {
+    if (BL_TUNE_DONE == status)
+    {
+      BL_Tune_ack();
+      ol_table_print();
+      printf( (FALSE != Mdata_Save()) ? "OL TUNE OK\r\n" : "OL TUNE ERR\r\n" );
+    }
+    else if (BL_TUNE_FAIL == status)
+    {
+      BL_Tune_ack();
+      printf("OL TUNE ERR\r\n");
+    }
+  }
+}
+#endif // OL_TUNE_ENABLED
+
+/*
+ * Prints the throttle curve and, with the motor stopped, opens the input line
+ * for a new one (THR_CURVE_KNOTS permille values), see curve_line_input.
+ */
+static void curve_edit(void)
+{
+  uint8_t n;
+
+  printf("CURVE");
+  for (n = 0; n < THR_CURVE_KNOTS; n++)
+  {
+    printf(" %u", (uint16_t)( ((uint32_t)Thr_curve_Get(n) * CURVE_PM_MAX) / DC_100PCNT ));
+  }
+  printf("\r\n");
+
+  if (BL_NOT_RUNNING != BL_get_state())
+  {
+    return;
+  }
+
+  printf("? ");
+  Curve_pm = 0;
+  Curve_digits = FALSE;
+  Curve_n = 0;
+  Curve_line = TRUE;
+}
+
+/*
+ * One character of the throttle curve input line, read at the task rate so the
+ * background task is not held up waiting for the line (it is to be typed, a
+ * pasted line overruns the receive register). The curve is applied once the
+ * line is complete, only if the motor is still stopped. An empty line keeps the
+ * curve, a bad curve is not applied.
+ */
+static void curve_line_input(char c)
+{
+  putchar(c);
+
+  if (c >= '0' && c <= '9')
+  {
+    if (Curve_pm <= CURVE_PM_MAX)
+    {
+      Curve_pm = (Curve_pm * 10) + (c - '0');
+    }
+    Curve_digits = TRUE;
+  }
+  else if (FALSE != Curve_digits)
+  {
+    if (Curve_n < THR_CURVE_KNOTS && Curve_pm <= CURVE_PM_MAX)
+    {
+      Curve_knots[Curve_n] = (uint16_t)( ((uint32_t)Curve_pm * DC_100PCNT) / CURVE_PM_MAX );
+    }
+    else
+    {
+      Curve_n = THR_CURVE_KNOTS; // too many or out of range, count is invalid
+    }
+    Curve_n += 1;
+    Curve_pm = 0;
+    Curve_digits = FALSE;
+  }
+
+  if ('\r' != c && '\n' != c)
+  {
+    return;
+  }
+
+  Curve_line = FALSE;
+  printf("\r\n");
+
+  if (Curve_n > 0)
+  {
+    if (THR_CURVE_KNOTS == Curve_n  &&  BL_NOT_RUNNING == BL_get_state()  &&
+        FALSE != Thr_curve_Set(Curve_knots))
+    {
+      printf("CURVE OK\r\n");
+    }
+    else
+    {
+      printf("CURVE ERR\r\n");
+    }
+  }
+}
+
 static ui_handlrp_t handle_term_inp(void)
 {
   ui_handlrp_t fp = NULL;
@@ -298,6 +573,13 @@ static ui_handlrp_t handle_term_inp(void)
   if (SerialKeyPressed(&key))
   {
     int n;
+
+    // the throttle curve input line takes the characters, one per pass
+    if (FALSE != Curve_line)
+    {
+      curve_line_input(key);
+      return NULL;
+    }
     for (n = 0; n < _SIZE_K_LUT ; n++)
     {
       if (key == _GET_KEY_CODE( n ))
@@ -324,6 +606,13 @@ static ui_handlrp_t handle_term_inp(void)
 static void Periodic_task(void)
 {
   BL_RUNSTATE_t bl_state;
+#if defined( DSHOT_ENABLED )
+  dshot_cmd_t dshot_cmd;
+#endif
+#if defined( CURRENT_SENSE_ENABLED )
+  uint16_t isense;
+  uint8_t pwm_breaks;
+#endif
 
 // invoke the terminal input and ui speed subs, updates from their globals to occur in the CS
   ui_handlrp_t fp = handle_term_inp();
@@ -335,28 +624,108 @@ static void Periodic_task(void)
     fp();
   }
 
+#if defined( DSHOT_ENABLED )
+  // DShot sets the speed directly, only the logger needs the UI speed (the
+  // same duty-cycle command as applied, 0 if stopped or a command)
+  UI_Speed = Dshot_Get_throttle();
+  UI_Speed = (0 != UI_Speed) ? DSHOT_DC(UI_Speed) : 0;
+  dshot_cmd = Dshot_Get_command();
+#else
   // update the UI speed input slider+trim
   set_ui_speed();
 
+#if defined( HAS_SERVO_INPUT )
+  // a qualified throttle signal is applied at the control rate, see Throttle_Update
+  if (THR_SIG_NONE == Throttle_Get_signal())
+  {
+    BLDC_PWMDC_Set(UI_Speed);
+  }
+#else
   BLDC_PWMDC_Set(UI_Speed);
+#endif
+#endif
 
   bl_state = BL_get_state();
 
   Vsystem = ( Seq_Get_Vbatt() + Vsystem ) / 2; // sma
 
+#if defined( CURRENT_SENSE_ENABLED )
+  isense = Driver_Get_Current();
+  pwm_breaks = Driver_Get_PWM_breaks();
+#endif
+
   enableInterrupts();  ///////////////// EI EI O
 
 #if defined( UNDERVOLTAGE_FAULT_ENABLED )
   // update system voltage diagnostic - check plausibilty of Vsys
+  // (soft fault, a collapsing supply is caught by the fast check in the ADC ISR)
   if (BL_IS_RUNNING == bl_state  && Vsystem > 0  )
   {
     Faultm_upd(VOLTAGE_NG, (faultm_assert_t)( Vsystem < V_SHUTDOWN_THR) );
   }
+#endif
+#if defined( CURRENT_SENSE_ENABLED )
+  // over-current diagnostic: average current beyond what the limit loop should
+  // allow, or the hardware limit is chopping persistently (stall/short)
+  if (BL_IS_RUNNING == bl_state)
+  {
+    Faultm_upd(CURRENT_NG,
+               (faultm_assert_t)( isense > ISENSE_FAULT_THR  ||  pwm_breaks > ISENSE_BRK_THR ) );
+  }
+#endif
+#if defined( DSHOT_ENABLED )
+  // no settings are implemented, commands are only logged
+  if (DSHOT_CMD_NONE != dshot_cmd)
+  {
+    printf("DSHOT CMD %d\r\n", (int)dshot_cmd);
+  }
+#elif defined( HAS_SERVO_INPUT )
+  // EEPROM write of a learned throttle range (motor is stopped)
+  if (FALSE != Throttle_Task())
+  {
+    printf("THROTTLE RANGE LEARNED\r\n");
+  }
+#endif
+#if defined( HAS_SERVO_INPUT )
+  if (FALSE != Lat_report)
+  {
+    Lat_report = FALSE;
+    printf("LATENCY %u us MAX %u us\r\n",
+           Driver_Get_latency(), Driver_Get_latency_max());
+  }
+#endif
+  if (FALSE != St_report)
+  {
+    St_report = FALSE;
+    // time in state from the latest entry, control ticks (~1 ms)
+    printf("STATE %u CATCH %u ALIGN %u RAMP %u RUN %u ms\r\n", (uint16_t)BL_get_sm_state(),
+           BL_get_state_time(BL_ST_CATCH), BL_get_state_time(BL_ST_ALIGN),
+           BL_get_state_time(BL_ST_RAMP), BL_get_state_time(BL_ST_RUN));
+  }
+  if (FALSE != Curve_edit)
+  {
+    Curve_edit = FALSE;
+    curve_edit();
+  }
+#if defined( OL_TUNE_ENABLED )
+  ol_tune_task(bl_state);
+#endif
+#if defined( SCOPE_ENABLED )
+  // streaming of a completed capture has the terminal to itself
+  if (FALSE != Scope_Dump())
+  {
+    return;
+  }
+#endif
+#if defined( TELEM_ENABLED )
+  // telemetry frames have the UART, no continuous logging
+  Telem_Task();
+  Log_Level = 0;
 #endif
   /*
-   * debug logging to terminal
+   * debug logging to terminal (held while the curve input line is open)
    */
-  if (Log_Level > 0)
+  if (Log_Level > 0  &&  FALSE == Curve_line)
   {
     // if log level less than <threshold> then decrement the count
     if (Log_Level < 255)
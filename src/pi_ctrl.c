@@ -0,0 +1,78 @@
+/**
+  ******************************************************************************
+  * @file pi_ctrl.c
+  * @brief Fixed-point PI controller
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  */
+/**
+ * \defgroup pi_ctrl  PI Controller
+ * @brief Fixed-point PI controller
+ *
+ * @details Proportional-integral control with the gains in fixed-point. The
+ * output is clamped to the limits, and the integrator is clamped to the same
+ * limits (anti-windup) so that the output comes off the limit as soon as the
+ * sign of the error reverses.
+ * @{
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "pi_ctrl.h"
+
+
+/* Private functions ---------------------------------------------------------*/
+
+static int32_t clamp32(int32_t x, int16_t lo, int16_t hi)
+{
+  if (x < ( (int32_t)lo << PI_GAIN_SH ))
+  {
+    return (int32_t)lo << PI_GAIN_SH;
+  }
+  if (x > ( (int32_t)hi << PI_GAIN_SH ))
+  {
+    return (int32_t)hi << PI_GAIN_SH;
+  }
+  return x;
+}
+
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Reset the controller.
+ *
+ * @details The integrator is preset so that the output is continuous from
+ * the present value (bumpless transfer).
+ *
+ * @param p_pi  Controller
+ * @param out   Output with zero error
+ */
+void PI_ctrl_Reset(pi_ctrl_t * p_pi, int16_t out)
+{
+  p_pi->integ = clamp32( (int32_t)out << PI_GAIN_SH, p_pi->out_min, p_pi->out_max );
+}
+
+/**
+ * @brief Controller update.
+ *
+ * @param p_pi  Controller
+ * @param err   Control error
+ *
+ * @return  Output, within the limits
+ */
+int16_t PI_ctrl_Update(pi_ctrl_t * p_pi, int16_t err)
+{
+  int32_t acc;
+
+  p_pi->integ = clamp32( p_pi->integ + (int32_t)p_pi->ki * err,
+                         p_pi->out_min, p_pi->out_max );
+
+  acc = clamp32( p_pi->integ + (int32_t)p_pi->kp * err,
+                 p_pi->out_min, p_pi->out_max );
+
+  return (int16_t)( acc >> PI_GAIN_SH );
+}
+
+/**@}*/ // defgroup
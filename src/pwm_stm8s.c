@@ -44,6 +44,10 @@
 
 /* Private defines -----------------------------------------------------------*/
 
+// duty-cycle command to timer counts, fixed-point 16 fractional bits (rounded)
+#define PWM_DC_CMP_MUL  \
+  (uint16_t)( ( ( (uint32_t)PWM_100PCNT << 16 ) + (DC_100PCNT / 2) ) / DC_100PCNT )
+
 
 /* Private types -----------------------------------------------------------*/
 
@@ -54,6 +58,8 @@
 /* Private variables ---------------------------------------------------------*/
 static uint16_t global_uDC;
 
+static uint16_t compare_uDC; // duty-cycle last written to the compare registers
+
 
 /* Private function prototypes -----------------------------------------------*/
 
@@ -80,10 +86,44 @@ void All_phase_stop(void)
 /**
  * @brief Putter accessor for PWM duty cycle
  * @details Motor speed is controlled through the UI and converted to PWM duty cycle .
+ *
+ * @param global_dutycycle  Duty-cycle command [0:DC_100PCNT], scaled to
+ *  the PWM timer period
  */
 void set_dutycycle(uint16_t global_dutycycle)
 {
-    global_uDC = global_dutycycle;
+    uint16_t dc = (uint16_t)( ( (uint32_t)global_dutycycle * PWM_DC_CMP_MUL ) >> 16 );
+
+    if (dc > PWM_100PCNT)
+    {
+        dc = PWM_100PCNT;
+    }
+    global_uDC = dc;
+}
+
+/** @cond */ // hide the low-level code
+
+static void set_compare(uint16_t dc);
+
+/** @endcond */
+
+/**
+ * @brief Refresh the PWM compare registers
+ * @details Called from the PWM update ISR, so that a new duty-cycle takes
+ * effect at the next PWM period rather than at the next commutation step
+ * (which enables the phase with the present duty-cycle). Compare preload is
+ * enabled, so the new value is latched at the update event. Compares of
+ * disabled channels are written as well (no effect on the output).
+ */
+void PWM_Update_compare(void)
+{
+    uint16_t dc = global_uDC;
+
+    if (dc != compare_uDC)
+    {
+        compare_uDC = dc;
+        set_compare(dc);
+    }
 }
 
 /** @cond */ // hide the low-level code
@@ -97,7 +137,9 @@ void set_dutycycle(uint16_t global_dutycycle)
  * Setup TIM2 PWM
  * Reference: AN3332
  */
-#ifdef CLOCK_16
+#if defined( PWM_HIRES )
+#define TIM2_PRESCALER TIM2_PRESCALER_1  //    (1/fMASTER) * TIM2_PWM_PD -> 0.000125 S
+#elif defined( CLOCK_16 )
 #define TIM2_PRESCALER TIM2_PRESCALER_8  //    (1/16Mhz) * 8 * 250 -> 0.000125 S
 #else
 #define TIM2_PRESCALER TIM2_PRESCALER_4  //    (1/8Mhz)  * 4 * 250 -> 0.000125 S
@@ -116,15 +158,15 @@ void PWM_setup(void)
   TIM2_TimeBaseInit(TIM2_PRESCALER, TIM2_PWM_PD);
   /* Channel 1 PWM configuration */
   TIM2_OC1Init(TIM2_OCMODE_PWM2, TIM2_OUTPUTSTATE_ENABLE, 0, TIM2_OCPOLARITY_LOW );
-//  TIM2_OC1PreloadConfig(ENABLE);
+  TIM2_OC1PreloadConfig(ENABLE); // compare refreshed each period, see PWM_Update_compare
 
   /* Channel 2 PWM configuration */
   TIM2_OC2Init(TIM2_OCMODE_PWM2, TIM2_OUTPUTSTATE_ENABLE, 0, TIM2_OCPOLARITY_LOW );
-//  TIM2_OC2PreloadConfig(ENABLE);
+  TIM2_OC2PreloadConfig(ENABLE);
 
   /* Channel 3 PWM configuration */
   TIM2_OC3Init(TIM2_OCMODE_PWM2, TIM2_OUTPUTSTATE_ENABLE, 0, TIM2_OCPOLARITY_LOW );
-//  TIM2_OC3PreloadConfig(ENABLE);
+  TIM2_OC3PreloadConfig(ENABLE);
 
   /* Enables TIM2 peripheral Preload register on ARR */
 //  TIM2_ARRPreloadConfig(ENABLE);
@@ -169,9 +211,18 @@ void PWM_PhC_Enable(void)
     TIM2_CCxCmd( PWM_TIMER_CHAN_C, ENABLE );
 }
 
+static void set_compare(uint16_t dc)
+{
+    TIM2_SetCompare1( dc );
+    TIM2_SetCompare2( dc );
+    TIM2_SetCompare3( dc );
+}
+
 #elif defined ( S105_DEV )
 
-#ifdef CLOCK_16
+#if defined( PWM_HIRES )
+#define TIM1_PRESCALER 1  //    (1/fMASTER) * TIM2_PWM_PD -> 0.000125 S
+#elif defined( CLOCK_16 )
 #define TIM1_PRESCALER 8  //    (1/16Mhz) * 8 * 250 -> 0.000125 S
 #else
 #define TIM1_PRESCALER 4  //    (1/8Mhz)  * 4 * 250 -> 0.000125 S
@@ -222,6 +273,27 @@ void PWM_setup(void)
                  TIM1_OCPOLARITY_LOW,
                  TIM1_OCIDLESTATE_RESET);
 
+    // compare refreshed each period, see PWM_Update_compare
+    TIM1_OC2PreloadConfig(ENABLE);
+    TIM1_OC3PreloadConfig(ENABLE);
+    TIM1_OC4PreloadConfig(ENABLE);
+
+#if defined( CURRENT_SENSE_ENABLED ) && defined( HAS_PWM_BKIN )
+/*
+ * Over-current comparator (active low) on BKIN clears MOE asynchronously i.e.
+ * the PWM is cut within the same cycle. With automatic output enable, MOE is
+ * set again at the next update event, so the limit is cycle-by-cycle.
+ */
+    TIM1_BDTRConfig( TIM1_OSSISTATE_ENABLE,
+                     TIM1_LOCKLEVEL_OFF,
+                     0, // dead-time is handled by the IR2104
+                     TIM1_BREAK_ENABLE,
+                     TIM1_BREAKPOLARITY_LOW,
+                     TIM1_AUTOMATICOUTPUT_ENABLE);
+
+    TIM1_ITConfig(TIM1_IT_BREAK, ENABLE);
+#endif
+
     TIM1_CtrlPWMOutputs(ENABLE);
 
     TIM1_ITConfig(TIM1_IT_UPDATE, ENABLE);  // for triggering ADC capture
@@ -263,6 +335,13 @@ void PWM_PhC_Enable(void)
     TIM1_CCxCmd( PWM_TIMER_CHAN_C, ENABLE );
 }
 
+static void set_compare(uint16_t dc)
+{
+    TIM1_SetCompare2( dc );
+    TIM1_SetCompare3( dc );
+    TIM1_SetCompare4( dc );
+}
+
 #endif // S105
 
 /** @endcond */
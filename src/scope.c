@@ -0,0 +1,235 @@
+/**
+  ******************************************************************************
+  * @file scope.c
+  * @brief Triggered capture of raw back-EMF samples
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  */
+/**
+ * \defgroup scope  Scope
+ * @brief Triggered capture of raw back-EMF samples
+ *
+ * @details The raw phase A ADC samples are recorded from the ADC ISR into a
+ * RAM ring, tagged with the commutation step and the timestamp in the sector.
+ * Once armed, the ring is filled continuously until the trigger condition, then
+ * the post-trigger samples are filled and the capture is frozen. The capture is
+ * then streamed over the UART by the background task, a few lines at a time,
+ * so that the ISRs are not perturbed. See tools/scope.py for the host side.
+ * @{
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include <stdio.h>
+
+#include "scope.h"
+
+#if defined( SCOPE_ENABLED )
+
+#include "sequence.h"
+#include "faultm.h"
+#include "bldc_sm.h"
+
+
+/* Private defines -----------------------------------------------------------*/
+
+// 5 bytes per sample, 240 bytes of RAM
+#define SCOPE_NSAMPLES   48
+
+// number of samples recorded ahead of (and including) the trigger
+#define SCOPE_PRE_TRIG   16
+
+// step trigger: phase A floating-falling
+#define SCOPE_TRIG_STEP_NR  2
+
+// error trigger: threshold of the timing error ratio (scaled by 64)
+#define SCOPE_ERR_THR    0x0010
+
+// number of lines printed per background task period while streaming
+#define SCOPE_DUMP_LINES  4
+
+/* Private types -----------------------------------------------------------*/
+
+/**
+ * @brief Capture states
+ */
+typedef enum
+{
+  SCOPE_IDLE,
+  SCOPE_ARMED,     // filling the pre-trigger samples, waiting for trigger
+  SCOPE_TRIGGERED, // filling the post-trigger samples
+  SCOPE_DONE,      // capture complete, waiting for the background task
+  SCOPE_STREAM     // capture is being streamed
+} scope_state_t;
+
+/**
+ * @brief Captured sample
+ */
+typedef struct
+{
+  uint16_t adc;     /**< Raw ADC channel 0 */
+  uint16_t tstamp;  /**< Timestamp relative to start of sector */
+  uint8_t step;     /**< Commutation step index */
+} scope_sample_t;
+
+
+/* Private variables ---------------------------------------------------------*/
+
+static scope_sample_t Scope_buf[SCOPE_NSAMPLES];
+
+static uint8_t Scope_wr;       // ring index of the next sample (oldest sample when done)
+static uint8_t Scope_count;    // samples remaining to fill before trigger, or after
+static uint8_t Scope_prev_step;
+static uint16_t Scope_ctm;     // commutation period at the trigger
+
+static scope_state_t Scope_state;
+static scope_trig_t Scope_trig;
+
+
+/* Private functions ---------------------------------------------------------*/
+
+static uint8_t is_triggered(uint8_t step)
+{
+  int16_t err;
+
+  switch(Scope_trig)
+  {
+  case SCOPE_TRIG_FAULT:
+    return (0 != Faultm_get_status());
+
+  case SCOPE_TRIG_STEP:
+    return (step != Scope_prev_step && SCOPE_TRIG_STEP_NR == step);
+
+  case SCOPE_TRIG_ERROR:
+    err = Seq_get_timing_error();
+    return (err > SCOPE_ERR_THR || err < -SCOPE_ERR_THR);
+
+  default:
+    return FALSE;
+  }
+}
+
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Arm the capture.
+ *
+ * @details Restarts the capture if it was already armed or streaming.
+ *
+ * @param trig  Trigger source
+ */
+void Scope_Arm(scope_trig_t trig)
+{
+  Scope_trig = trig;
+  Scope_wr = 0;
+  Scope_count = SCOPE_PRE_TRIG;
+  Scope_prev_step = Seq_Get_Step();
+  Scope_state = SCOPE_ARMED;
+}
+
+/**
+ * @brief Record a sample.
+ *
+ * @details Called from the ADC ISR, so does nothing unless a capture is in
+ * progress.
+ *
+ * @param adc     Raw ADC channel 0
+ * @param tstamp  Timestamp relative to start of sector
+ */
+void Scope_Sample(uint16_t adc, uint16_t tstamp)
+{
+  scope_sample_t * p_sample;
+  uint8_t step;
+
+  if (SCOPE_ARMED != Scope_state && SCOPE_TRIGGERED != Scope_state)
+  {
+    return;
+  }
+
+  step = Seq_Get_Step();
+
+  p_sample = &Scope_buf[Scope_wr];
+  p_sample->adc = adc;
+  p_sample->tstamp = tstamp;
+  p_sample->step = step;
+
+  if (++Scope_wr >= SCOPE_NSAMPLES)
+  {
+    Scope_wr = 0;
+  }
+
+  if (Scope_count > 0)
+  {
+    Scope_count -= 1;
+  }
+
+  if (SCOPE_TRIGGERED == Scope_state)
+  {
+    if (0 == Scope_count)
+    {
+      Scope_state = SCOPE_DONE;
+    }
+  }
+  else if (0 == Scope_count && is_triggered(step))
+  {
+    Scope_count = SCOPE_NSAMPLES - SCOPE_PRE_TRIG;
+    Scope_ctm = get_commutation_period();
+    Scope_state = SCOPE_TRIGGERED;
+  }
+
+  Scope_prev_step = step;
+}
+
+/**
+ * @brief Stream the completed capture.
+ *
+ * @details Called from the background task. A header line gives the capture
+ * parameters, followed by 1 line per sample (oldest first) of step, timestamp
+ * and ADC, ending with an end marker line.
+ *
+ * @return  TRUE while streaming (the caller should hold off other output)
+ */
+uint8_t Scope_Dump(void)
+{
+  static uint8_t rd_count;
+  uint8_t n;
+
+  if (SCOPE_DONE == Scope_state)
+  {
+    // sample at the write index is the oldest as the ring has wrapped
+    rd_count = 0;
+    Scope_state = SCOPE_STREAM;
+
+    printf("#SCOPE N=%d PRE=%d TRG=%d CT=%04X\r\n",
+           SCOPE_NSAMPLES, SCOPE_PRE_TRIG, (int)Scope_trig, Scope_ctm);
+  }
+
+  if (SCOPE_STREAM != Scope_state)
+  {
+    return FALSE;
+  }
+
+  for (n = 0; n < SCOPE_DUMP_LINES && rd_count < SCOPE_NSAMPLES; n++)
+  {
+    scope_sample_t * p_sample =
+      &Scope_buf[ (Scope_wr + rd_count) % SCOPE_NSAMPLES ];
+
+    printf("%d %04X %04X\r\n",
+           (int)p_sample->step, p_sample->tstamp, p_sample->adc);
+
+    rd_count += 1;
+  }
+
+  if (rd_count >= SCOPE_NSAMPLES)
+  {
+    printf("#END\r\n");
+    Scope_state = SCOPE_IDLE;
+  }
+  return TRUE;
+}
+
+#endif // SCOPE_ENABLED
+
+/**@}*/ // defgroup
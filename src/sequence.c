@@ -18,6 +18,7 @@
 #include "pwm_stm8s.h"
 #include "driver.h"
 #include "bldc_sm.h"
+#include "median3.h"
 
 
 /* Private defines -----------------------------------------------------------*/
@@ -30,6 +31,9 @@
  */
 #define  BACK_EMF_PLAUS_THR  0x03F8
 
+// the alignment step applies the complete phase pattern (A PWM, B low, C float)
+#define SEQ_ALIGN_STEP  0
+
 /* Private types -----------------------------------------------------------*/
 
 
@@ -66,6 +70,17 @@ uint16_t Back_EMF_Riseing_PhX;
 
 static uint16_t Vbatt_;
 
+static uint8_t Seq_step; // index of the commutation step presently applied
+
+#if defined( CATCH_ENABLED )
+static uint8_t Seq_held; // bridge off while sensing a spinning rotor
+#endif
+
+#ifdef BEMF_MEDIAN_FILT
+static median3_t Bemf_R_hist;
+static median3_t Bemf_F_hist;
+#endif
+
 static const step_ptr_t step_ptr_table[] =
 {
   sector_0,
@@ -91,19 +106,62 @@ static int16_t comm_tm_err_ratio;
 #define SCALE_64_LSH   6
 #define SCALE_64_ONE  (1 << SCALE_64_LSH)
 
+#if defined( ZC_TIMING_ENABLED )
+static uint8_t Zc_valid; // the timing error is from the zero-crossing time
+#endif
+
 
 /* Private functions ---------------------------------------------------------*/
 
+/*
+ * Get the back-EMF sample from the sector in which phase A was floating.
+ */
+static uint16_t get_bemf_sample(void)
+{
+#ifdef BUFFER_ADC_BEMF
+  return Driver_Get_Back_EMF_Avg();
+#else
+  return Driver_Get_ADC();
+#endif
+}
+
+#ifdef BEMF_MEDIAN_FILT
+// single outliers are rejected, a step is passed with 1 electrical cycle delay
+#define BEMF_FILT(_HIST_, _SAMPLE_)  Median3( &(_HIST_), (_SAMPLE_) )
+#else
+#define BEMF_FILT(_HIST_, _SAMPLE_)  (_SAMPLE_)
+#endif
+
+#if defined( ZC_TIMING_ENABLED )
+/*
+ * Timing error from the zero-crossing time of the falling back-EMF on phase A,
+ * which is nominally at the middle of the sector. A zero-crossing late in the
+ * sector is advanced timing. The error is scaled to the units of the ratio of
+ * the back-EMF samples, i.e. +/- 64 at the end/start of the sector, so the
+ * control gains are the same. If no crossing was found the ratio is used.
+ */
+static void zc_timing_update(void)
+{
+  uint16_t zc_tm = Driver_Get_ZC_tm();
+  int32_t half = (int32_t)get_commutation_period() * 2; // 2 of 4 1/4 sectors
+
+  Zc_valid = (uint8_t)( zc_tm < (half * 2) );
+
+  if (FALSE != Zc_valid)
+  {
+    comm_tm_err_ratio =
+      (int16_t)( ( ((int32_t)zc_tm - half) << SCALE_64_LSH ) / half );
+  }
+}
+#endif
+
 static void sector_0(void)
 {
 //    { DC_OUTP_HI,       DC_OUTP_LO,       DC_OUTP_FLOAT_F,
 
 // previously phase-A was floating-rising transition
-#ifdef BUFFER_ADC_BEMF
-  Back_EMF_Riseing_PhX = ( Back_EMF_Riseing_PhX + Driver_Get_Back_EMF_Avg() ) >> 1 ;
-#else
-  Back_EMF_Riseing_PhX = ( Back_EMF_Riseing_PhX + Driver_Get_ADC() ) >> 1 ;
-#endif
+  Back_EMF_Riseing_PhX =
+    ( Back_EMF_Riseing_PhX + BEMF_FILT( Bemf_R_hist, get_bemf_sample() ) ) >> 1 ;
 //PWM OFF: C
   PWM_PhC_Disable();
 
@@ -142,6 +200,11 @@ static void sector_2(void)
   // Phase A was driven pwm, so use the ADC measurement as vbat
   Vbatt_ = Driver_Get_ADC();
 
+#if defined( ZC_TIMING_ENABLED )
+  // back-EMF zero-crossing is referenced to the motor neutral i.e. 1/2 Vbatt
+  Driver_Set_ZC_ref(Vbatt_ >> 1);
+#endif
+
 //    { DC_OUTP_FLOAT_F,  DC_OUTP_HI,       DC_OUTP_LO,
 
 //PWM OFF: A
@@ -161,12 +224,14 @@ static void sector_2(void)
 
 static void sector_3(void)
 {
-// previously phase-A was floating-falling transition
-#ifdef BUFFER_ADC_BEMF
-  Back_EMF_Falling_PhX = ( Back_EMF_Falling_PhX + Driver_Get_Back_EMF_Avg() ) >> 1;
-#else
-  Back_EMF_Falling_PhX = ( Back_EMF_Falling_PhX + Driver_Get_ADC() ) >> 1;
+#if defined( ZC_TIMING_ENABLED )
+  // phase A was floating-falling, the crossing is latched until the next sector
+  zc_timing_update();
 #endif
+
+// previously phase-A was floating-falling transition
+  Back_EMF_Falling_PhX =
+    ( Back_EMF_Falling_PhX + BEMF_FILT( Bemf_F_hist, get_bemf_sample() ) ) >> 1;
 //    { DC_OUTP_LO,       DC_OUTP_HI,       DC_OUTP_FLOAT_R,
 
 //PWM OFF:
@@ -221,9 +286,16 @@ static void sector_5(void)
   // ADC 10-bit i.e. 0x03FF << 6 = 0xFFC0
   // Calculation result gets scaled down in conjunction with factoring in of
   //  controller gain term(s).
-  comm_tm_err_ratio =
-    (int16_t)( ( Back_EMF_Falling_PhX << SCALE_64_LSH ) / Back_EMF_Riseing_PhX )
-    - (int16_t)SCALE_64_ONE;
+#if defined( ZC_TIMING_ENABLED )
+  if (FALSE == Zc_valid  &&  0 != Back_EMF_Riseing_PhX)
+#else
+  if (0 != Back_EMF_Riseing_PhX)
+#endif
+  {
+    comm_tm_err_ratio =
+      (int16_t)( ( Back_EMF_Falling_PhX << SCALE_64_LSH ) / Back_EMF_Riseing_PhX )
+      - (int16_t)SCALE_64_ONE;
+  }
 }
 
 /* Public functions ---------------------------------------------------------*/
@@ -283,6 +355,17 @@ uint16_t Seq_Get_Vbatt(void)
   return Vbatt_;
 }
 
+/**
+ * @brief Accessor for the commutation step index.
+ *
+ * @details Phase A is driven PWM in steps 0 and 1, floating (falling) in step 2,
+ * driven low in steps 3 and 4, and floating (rising) in step 5.
+ */
+uint8_t Seq_Get_Step(void)
+{
+  return Seq_step;
+}
+
 /**
  * @brief  Updates the commutation-step sequence.
  *
@@ -318,23 +401,84 @@ void Sequence_Step(void)
   // note this sizeof and divide done in preprocessor - verified in the assembly
   const uint8_t N_CSTEPS = sizeof(step_ptr_table) / sizeof(step_ptr_t);
 
-  static uint8_t s_step;
+  // rotor alignment: the alignment step is held, and the sequence starts from
+  // the adjacent step
+  if (BL_ST_ALIGN == BL_get_sm_state())
+  {
+    Seq_step = SEQ_ALIGN_STEP;
+    step_ptr_table[Seq_step]();
+
+    Back_EMF_Riseing_PhX = Back_EMF_Falling_PhX = 0;
+    return;
+  }
+
+#if defined( CATCH_ENABLED )
+  // catching a spinning rotor: bridge is off until synchronized to the rotor
+  if (FALSE != Seq_held)
+  {
+    Back_EMF_Riseing_PhX = Back_EMF_Falling_PhX = 0;
+    return;
+  }
+#endif
 
 // has to cast modulus expression to uint8
-  s_step = (uint8_t)((s_step + 1) % N_CSTEPS);
+  Seq_step = (uint8_t)((Seq_step + 1) % N_CSTEPS);
 
 // intentionally letting motor windmill (i.e. not braking) when switched off
 // normally
   if (BL_IS_RUNNING == BL_get_state() )
   {
     // let'er rip!
-    step_ptr_table[s_step]();
+    step_ptr_table[Seq_step]();
   }
   else
   {
     // intitialize the averages measurements 
     Back_EMF_Riseing_PhX = Back_EMF_Falling_PhX = Vbatt_ = 0;
+#ifdef BEMF_MEDIAN_FILT
+    // the first samples seed the history, else the output starts from 0
+    Median3_Reset(&Bemf_R_hist);
+    Median3_Reset(&Bemf_F_hist);
+#endif
+#if defined( ZC_TIMING_ENABLED )
+    Zc_valid = FALSE;
+#endif
   }
 }
 
+#if defined( CATCH_ENABLED )
+/**
+ * @brief Hold the sequence with the bridge off.
+ *
+ * @param hold  TRUE to hold, FALSE to resume the sequence from the present step
+ */
+void Seq_Hold(uint8_t hold)
+{
+  Seq_held = hold;
+}
+
+/**
+ * @brief Start the sequence at the given commutation step.
+ *
+ * @details Synchronizes to a spinning rotor, with the bridge off. The odd
+ *  steps only switch the phases that change from the preceding step, so the
+ *  preceding step is applied first.
+ *
+ * @param step  Commutation step
+ */
+void Seq_Set_step(uint8_t step)
+{
+  Seq_step = step;
+
+  if (0 != (Seq_step & 1))
+  {
+    step_ptr_table[Seq_step - 1]();
+  }
+  step_ptr_table[Seq_step]();
+
+  Back_EMF_Riseing_PhX = Back_EMF_Falling_PhX = 0;
+  Seq_held = FALSE;
+}
+#endif
+
 /**@}*/ // defgroup
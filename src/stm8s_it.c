@@ -14,6 +14,7 @@
 #include "stm8s_it.h"
 #include "system.h"
 #include "driver.h"
+#include "mcu_stm8s.h"
 
 
 /** @addtogroup Template_Project
@@ -100,9 +101,10 @@ INTERRUPT_HANDLER(CLK_IRQHandler, 2)
   */
 INTERRUPT_HANDLER(EXTI_PORTA_IRQHandler, 3)
 {
-  /* In order to detect unexpected events during development,
-     it is recommended to set a breakpoint on the following instruction.
-  */
+#if defined( S003_DEV ) && defined( HAS_SERVO_INPUT )
+    // read the pin first thing, as close to the edge as possible
+    Driver_on_servo_edge( (uint8_t)( 0 != ( SERVO_GPIO_PORT->IDR & SERVO_GPIO_PIN ) ) );
+#endif
 }
 
 /**
@@ -229,6 +231,25 @@ INTERRUPT_HANDLER(TIM1_UPD_OVF_TRG_BRK_IRQHandler, 11)
     static const int Frame_count = 4;
     static uint8_t frame_counter = 0;
 
+#if defined( CURRENT_SENSE_ENABLED ) && defined( HAS_PWM_BKIN )
+    if ( 0 != TIM1_GetFlagStatus(TIM1_FLAG_BREAK) )
+    {
+        Driver_on_PWM_break(); // PWM already cut by hardware
+
+        // the flag is set again for as long as the comparator is active, so
+        // the break IT is re-armed at the next update i.e. 1 per PWM cycle
+        TIM1_ITConfig(TIM1_IT_BREAK, DISABLE);
+        TIM1_ClearITPendingBit(TIM1_IT_BREAK);
+        TIM1_ClearFlag(TIM1_FLAG_BREAK);
+    }
+    // break shares the vector so the update event has to be qualified
+    if ( 0 == TIM1_GetFlagStatus(TIM1_FLAG_UPDATE) )
+    {
+        return;
+    }
+    TIM1_ITConfig(TIM1_IT_BREAK, ENABLE);
+#endif
+
 // note pre-increment on variable 
     if ( ++frame_counter >= Frame_count )
     {
@@ -252,6 +273,16 @@ INTERRUPT_HANDLER(TIM1_UPD_OVF_TRG_BRK_IRQHandler, 11)
 INTERRUPT_HANDLER(TIM1_CAP_COM_IRQHandler, 12)
 {
 #if defined( S105_DISCOVERY ) && defined( HAS_SERVO_INPUT )
+#if defined( DSHOT_BIDIR )
+// telemetry response bit first, the flag is cleared before as the handler
+// re-arms the compare
+    if ( 0 != TIM1_GetITStatus(TIM1_IT_CC1) )
+    {
+        TIM1_ClearITPendingBit(TIM1_IT_CC1);
+        Driver_on_servo_compare();
+    }
+    else
+#endif
     if ( 0 != TIM1_GetFlagStatus(TIM1_FLAG_CC3) )
     {
 //        GPIOD->ODR &=  ~(1<<LED); // clear test pin
@@ -330,20 +361,31 @@ INTERRUPT_HANDLER(TIM1_CAP_COM_IRQHandler, 12)
  {
 #if defined( S105_DEV ) && defined( HAS_SERVO_INPUT )
 
-    if ( 0 != TIM2_GetFlagStatus(TIM2_FLAG_CC1) )
+#if defined( DSHOT_BIDIR )
+// telemetry response bit first, the flag is cleared before as the handler
+// re-arms the compare
+    if ( 0 != TIM2_GetITStatus(TIM2_IT_CC3) )
     {
-        Driver_on_capture_rise();
-
-        TIM2_ClearITPendingBit(TIM2_IT_CC1);
-        TIM2_ClearFlag(TIM2_FLAG_CC1);
+        TIM2_ClearITPendingBit(TIM2_IT_CC3);
+        Driver_on_servo_compare();
     }
-    else if ( 0 != TIM2_GetFlagStatus(TIM2_FLAG_CC2) )
+    else
+#endif
+// falling edge first: with DShot the rising edge flag is set but not serviced
+    if ( 0 != TIM2_GetFlagStatus(TIM2_FLAG_CC2) )
     {
         Driver_on_capture_fall();
 
         TIM2_ClearITPendingBit(TIM2_IT_CC2);
         TIM2_ClearFlag(TIM2_FLAG_CC2);
     }
+    else if ( 0 != TIM2_GetFlagStatus(TIM2_FLAG_CC1) )
+    {
+        Driver_on_capture_rise();
+
+        TIM2_ClearITPendingBit(TIM2_IT_CC1);
+        TIM2_ClearFlag(TIM2_FLAG_CC1);
+    }
 #endif
  }
 #endif /* (STM8S903) || (STM8AF622x) */
@@ -387,9 +429,9 @@ INTERRUPT_HANDLER(TIM1_CAP_COM_IRQHandler, 12)
   */
  INTERRUPT_HANDLER(UART1_TX_IRQHandler, 17)
  {
-    /* In order to detect unexpected events during development,
-       it is recommended to set a breakpoint on the following instruction.
-    */
+#if defined( TELEM_ENABLED )
+    MCU_uart_on_tx(); // data register empty, cleared by the write
+#endif
  }
 
 /**
@@ -451,9 +493,9 @@ INTERRUPT_HANDLER(I2C_IRQHandler, 19)
   */
  INTERRUPT_HANDLER(UART2_TX_IRQHandler, 20)
  {
-    /* In order to detect unexpected events during development,
-       it is recommended to set a breakpoint on the following instruction.
-    */
+#if defined( TELEM_ENABLED )
+    MCU_uart_on_tx(); // data register empty, cleared by the write
+#endif
  }
 
 /**
@@ -0,0 +1,178 @@
+/**
+  ******************************************************************************
+  * @file telem.c
+  * @brief ESC serial telemetry
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  */
+/**
+ * \defgroup telem  Telemetry
+ * @brief ESC serial telemetry
+ *
+ * @details The KISS/BLHeli_32 ESC telemetry frame, 10 bytes with 16-bit
+ * fields MSB first:
+ *   temperature (deg C) | voltage (0.01 V) | current (0.01 A) |
+ *   consumption (mAh) | eRPM/100 | CRC-8 (polynomial 0x07)
+ *
+ * The frame is sent on request (the DShot telemetry bit) or, without DShot,
+ * at a fixed rate. It is built in the background task and sent from the UART
+ * transmit ISR so the background task does not wait on the UART. The UART is
+ * shared with the terminal, so the continuous debug logger is not printed when
+ * telemetry is enabled.
+ *
+ * The DShot request is latched by the DShot ISR and serviced by the background
+ * task, so the frame starts up to one task period (TELEM_TASK_MS, 16 ms at
+ * 16 MHz) after the request, and requests in the same period are answered with
+ * one frame. The frame is not started from the DShot ISR as the terminal
+ * output of the background task would interleave with it on the UART. A
+ * flight controller polling the ESC should allow this latency before timing
+ * out the response.
+ *
+ * There is no temperature sensor, so the temperature is reported as 0, and
+ * the current and consumption are 0 unless current sensing is enabled.
+ * @{
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "telem.h"
+
+#if defined( TELEM_ENABLED )
+
+#include "mcu_stm8s.h"
+#include "bldc_sm.h"
+#include "sequence.h"
+#include "driver.h"
+#include "dshot.h"
+#include "crc8.h"
+
+
+/* Private defines -----------------------------------------------------------*/
+
+// Vbatt ADC counts to 0.01 V: 5 V reference over 1024 counts, divider
+// 18k/(18k+33k) i.e. 14.17 V full-scale
+#define TELEM_CV_FS        1417
+
+// shunt amplifier ADC counts to 0.01 A: ~20.5 counts/A, fixed-point 8 bits
+#define TELEM_CA_CNT_Q8    1249
+
+// background task period (ms), for the consumption integral
+#ifdef CLOCK_16
+#define TELEM_TASK_MS      16
+#else
+#define TELEM_TASK_MS      32
+#endif
+
+// accumulated 0.01 A * task periods per mAh
+#define TELEM_CA_PER_MAH   ( 360000UL / TELEM_TASK_MS )
+
+// fixed rate without DShot request, in background task periods (~100 ms)
+#define TELEM_RATEM        ( 100 / TELEM_TASK_MS )
+
+
+/* Private variables ---------------------------------------------------------*/
+
+static uint8_t Frame[ TELEM_FRAME_LEN ];
+
+#if defined( CURRENT_SENSE_ENABLED )
+static uint32_t Consumed_acc;  // 0.01 A * task periods
+static uint16_t Consumed_mah;
+#endif
+
+
+/* Private functions ---------------------------------------------------------*/
+
+static void put16(uint8_t * p_buf, uint16_t value)
+{
+  p_buf[0] = (uint8_t)(value >> 8);
+  p_buf[1] = (uint8_t)value;
+}
+
+/*
+ * eRPM/100, 0 if stopped
+ */
+static uint16_t get_erpm100(void)
+{
+  uint16_t ctm = get_commutation_period();
+
+  if (BL_IS_RUNNING != BL_get_state() || 0 == ctm)
+  {
+    return 0;
+  }
+  return (uint16_t)( COMM_ERPM100_NUM / ctm );
+}
+
+/*
+ * Build the frame from the present measurements.
+ */
+static void build_frame(uint16_t cur_ca)
+{
+  uint16_t cv = (uint16_t)( ( (uint32_t)Seq_Get_Vbatt() * TELEM_CV_FS ) >> 10 );
+
+  Frame[0] = 0; // temperature, no sensor
+  put16( &Frame[1], cv );
+  put16( &Frame[3], cur_ca );
+#if defined( CURRENT_SENSE_ENABLED )
+  put16( &Frame[5], Consumed_mah );
+#else
+  put16( &Frame[5], 0 );
+#endif
+  put16( &Frame[7], get_erpm100() );
+  Frame[9] = Crc8( Frame, TELEM_FRAME_LEN - 1 );
+}
+
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Telemetry task.
+ *
+ * @details Called from the background task (~60 Hz). Integrates the current
+ * consumption and sends the telemetry frame when requested or due, i.e. a
+ * DShot request is answered at the next task pass.
+ */
+void Telem_Task(void)
+{
+#if !defined( DSHOT_ENABLED )
+  static uint8_t ratem = 0;
+#endif
+  uint16_t cur_ca = 0;
+  uint8_t send;
+
+#if defined( CURRENT_SENSE_ENABLED )
+  // the shunt is sampled in the PWM on-time, the supply current is the
+  // on-time current * duty-cycle
+  cur_ca = (uint16_t)( ( (uint32_t)Driver_Get_Current() * TELEM_CA_CNT_Q8 ) >> 8 );
+  cur_ca = (uint16_t)( ( (uint32_t)cur_ca * BLDC_PWMDC_Get() ) / DC_100PCNT );
+
+  Consumed_acc += cur_ca;
+  while (Consumed_acc >= TELEM_CA_PER_MAH)
+  {
+    Consumed_acc -= TELEM_CA_PER_MAH;
+    Consumed_mah += 1;
+  }
+#endif
+
+#if defined( DSHOT_ENABLED )
+  send = Dshot_Get_telem_req();
+#else
+  send = FALSE;
+  if (++ratem >= TELEM_RATEM)
+  {
+    ratem = 0;
+    send = TRUE;
+  }
+#endif
+
+  // the frame buffer is in use until the previous frame is sent
+  if (FALSE != send  &&  FALSE == MCU_uart_tx_busy())
+  {
+    build_frame(cur_ca);
+    MCU_uart_tx_start(Frame, TELEM_FRAME_LEN);
+  }
+}
+
+#endif // TELEM_ENABLED
+
+/**@}*/ // defgroup
@@ -0,0 +1,162 @@
+/**
+  ******************************************************************************
+  * @file thr_curve.c
+  * @brief Throttle curve
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  */
+/**
+ * \defgroup thr_curve  Throttle Curve
+ * @brief Throttle curve
+ *
+ * @details Piecewise-linear map of the throttle to the duty-cycle command,
+ * applied to the speed input ahead of the state machine (all throttle sources
+ * i.e. servo, DShot and the slider). Propeller thrust goes roughly with the
+ * square of the speed, so a curve can make the thrust response linear to the
+ * flight controller.
+ *
+ * The knots are evenly spaced over the throttle range and are in duty-cycle
+ * command units. The curve must be non-decreasing. Zero throttle always maps
+ * to 0 so that the motor can be stopped whatever the first knot. The default
+ * is linear. A curve loaded from the terminal is stored in the data EEPROM.
+ * @{
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "thr_curve.h"
+#include "eeprom.h"
+
+
+/* Private defines -----------------------------------------------------------*/
+
+#define THR_CURVE_SEGS   (THR_CURVE_KNOTS - 1)
+
+// input span of a segment
+#define THR_CURVE_STEP   (DC_100PCNT / THR_CURVE_SEGS)
+
+
+/* Private variables ---------------------------------------------------------*/
+
+static uint16_t Curve[ THR_CURVE_KNOTS ];
+
+
+/* Private functions ---------------------------------------------------------*/
+
+static void set_linear(void)
+{
+  uint8_t n;
+
+  for (n = 0; n < THR_CURVE_KNOTS; n++)
+  {
+    Curve[n] = (uint16_t)n * THR_CURVE_STEP;
+  }
+}
+
+static uint8_t is_valid(const uint16_t * p_knots)
+{
+  uint8_t n;
+
+  for (n = 0; n < THR_CURVE_KNOTS; n++)
+  {
+    if (p_knots[n] > DC_100PCNT  ||  ( n > 0  &&  p_knots[n] < p_knots[n - 1] ))
+    {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Load the throttle curve.
+ *
+ * @details Called once at startup, before interrupts are enabled. The curve
+ * is linear if none is stored.
+ */
+void Thr_curve_Init(void)
+{
+  if ( FALSE == Eeprom_Load(EE_OFFS_CURVE, Curve, sizeof(Curve))  ||
+       FALSE == is_valid(Curve) )
+  {
+    set_linear();
+  }
+}
+
+/**
+ * @brief Apply the throttle curve.
+ *
+ * @details Called on the control path (ISR), linear interpolation between the
+ * knots.
+ *
+ * @param dc  Throttle, duty-cycle command [0:DC_100PCNT]
+ *
+ * @return  Duty-cycle command
+ */
+uint16_t Thr_curve_Apply(uint16_t dc)
+{
+  uint16_t seg;
+  uint16_t frac;
+
+  if (0 == dc)
+  {
+    return 0;
+  }
+  if (dc >= DC_100PCNT)
+  {
+    return Curve[ THR_CURVE_SEGS ];
+  }
+
+  seg = dc / THR_CURVE_STEP;
+  frac = dc - (seg * THR_CURVE_STEP);
+
+  // the curve is non-decreasing
+  return Curve[seg] + (uint16_t)( ( (uint32_t)(Curve[seg + 1] - Curve[seg]) * frac ) /
+                                  THR_CURVE_STEP );
+}
+
+/**
+ * @brief Set the throttle curve.
+ *
+ * @details Called from the background task with the motor stopped, the curve
+ * is saved to the EEPROM (blocks for a few ms per byte).
+ *
+ * @param p_knots  THR_CURVE_KNOTS duty-cycle commands, non-decreasing
+ *
+ * @return  TRUE if the curve is valid and saved
+ */
+uint8_t Thr_curve_Set(const uint16_t * p_knots)
+{
+  uint8_t n;
+
+  if (FALSE == is_valid(p_knots))
+  {
+    return FALSE;
+  }
+
+  disableInterrupts();
+  for (n = 0; n < THR_CURVE_KNOTS; n++)
+  {
+    Curve[n] = p_knots[n];
+  }
+  enableInterrupts();
+
+  return Eeprom_Save(EE_OFFS_CURVE, Curve, sizeof(Curve));
+}
+
+/**
+ * @brief Accessor for a knot of the throttle curve.
+ *
+ * @param knot  Index [0:THR_CURVE_KNOTS)
+ *
+ * @return  Duty-cycle command
+ */
+uint16_t Thr_curve_Get(uint8_t knot)
+{
+  return Curve[knot];
+}
+
+/**@}*/ // defgroup
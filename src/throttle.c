@@ -0,0 +1,633 @@
+/**
+  ******************************************************************************
+  * @file throttle.c
+  * @brief Pulse-width throttle input protocols
+  * @author Neidermeier
+  * @version
+  * @date Oct-2026
+  ******************************************************************************
+  */
+/**
+ * \defgroup throttle  Throttle
+ * @brief Pulse-width throttle input protocols
+ *
+ * @details The protocol is detected from the captured pulse width: standard
+ * servo pulses are measured with the capture timer prescaler of 32, and if the
+ * pulse is too short to be resolved the capture is switched to prescaler 1 and
+ * the short pulse protocols (OneShot125, OneShot42, Multishot) are told apart
+ * by the width range. Each protocol is normalized to the same throttle range, so
+ * the speed setting does not depend on the protocol.
+ *
+ * Pulses are validated against a width and period window for the protocol, and
+ * a median-of-3 on the width rejects single glitches (i.e. motor noise coupled
+ * into the capture pin). The throttle is only passed on after a number of
+ * consecutive good frames, and if no good frame is received within the timeout
+ * the failsafe is applied.
+ *
+ * The endpoints of the detected protocol can be learned (the usual ESC
+ * throttle range learn): if the throttle is high when the signal is first
+ * qualified, the width is recorded as the maximum once it has been steady,
+ * then as the minimum once the throttle has been lowered and steady. The
+ * learned range is saved in the data EEPROM and used in place of the default
+ * range for that protocol. The motor is held stopped while learning.
+ * @{
+ */
+
+/* Includes ------------------------------------------------------------------*/
+#include "system.h"
+#include "throttle.h"
+
+#if defined( HAS_SERVO_INPUT ) && !defined( DSHOT_ENABLED )
+
+#if !defined( UNIT_TEST )
+#include "mcu_stm8s.h"
+#include "bldc_sm.h"
+#else
+void MCU_set_capture_fast(uint8_t fast);
+void BLDC_PWMDC_Set(uint16_t dc);
+#define disableInterrupts()
+#define enableInterrupts()
+#endif
+#include "eeprom.h"
+#include "median3.h"
+
+
+/* Private defines -----------------------------------------------------------*/
+
+// capture timer counts per us, prescaler 1
+#ifdef CLOCK_16
+#define TCK_US    16
+#else
+#define TCK_US    8
+#endif
+
+/*
+ * Capture timer counts per us, prescaler 32: taken from the frames measured
+ * with the developer radio rather than the nominal clock divide, i.e. widths of
+ * 0x044A - 0x0768 (1.1 - 1.9 ms) in frames of 0x55C0 (~22 ms, 45 Hz), so all of
+ * the slow timebase limits are in the same units as the measured endpoints.
+ */
+#define SLOW_TCK_US   1
+
+#define US_FAST( _US_ )  ( (_US_) * TCK_US )        // prescaler 1
+#define US_SLOW( _US_ )  ( (_US_) * SLOW_TCK_US )   // prescaler 32
+
+// servo pulse endpoints measured with the developer radio (prescaler 32)
+#define RF_PCNT_ZERO   0x044A
+#define RF_PCNT_100    0x0768
+
+// the receiver outputs frames of 0x2BB0 with the transmitter off (0x55C0 when
+// receiving), so the servo period window starts above it
+#define RF_NORDO_THR   0x3000
+
+// widths separating the protocols
+#define THR_FAST_MAX_US   300   // shorter pulses are a fast (OneShot/Multishot) protocol
+#define THR_OS125_MIN_US  100
+#define THR_OS42_MIN_US   30
+
+// consecutive pulses of the same protocol to lock on (or switch the prescaler)
+#define THR_DETECT_N     8
+
+// normalized throttle = (width - min) * scale >> THR_SCALE_SH, the duty-cycle
+// command in one multiply and shift (the scale fits 16 bits down to the
+// shortest learned span, 1/4 of the Multishot span i.e. 40 counts)
+#define THR_SCALE_SH     5
+
+// width window is the range extended by 1/8 range at either end
+#define THR_MARGIN( _MIN_, _MAX_ )  ( ( (_MAX_) - (_MIN_) ) >> 3 )
+
+#define THR_RANGE( _MIN_, _MAX_, _PERD_MIN_, _PERD_MAX_ ) \
+  { (_MIN_), (_MAX_), \
+    (uint16_t)( ( (uint32_t)THROTTLE_MAX << THR_SCALE_SH ) / ( (_MAX_) - (_MIN_) ) ), \
+    (_MIN_) - THR_MARGIN( _MIN_, _MAX_ ), (_MAX_) + THR_MARGIN( _MIN_, _MAX_ ), \
+    (_PERD_MIN_), (_PERD_MAX_) }
+
+// at prescaler 1 the period is not checked for max (the timer wraps at 4 ms)
+#define THR_PERD_ANY   0xFFFF
+
+// consecutive good frames before the throttle is passed on
+#define THR_GOOD_N       4
+
+/*
+ * Failsafe on loss of signal (no good frame within THR_LOSS_TMO control
+ * periods of ~1 ms):
+ *   THR_FS_HOLD - hold the last throttle for THR_FS_TIME then stop
+ *   THR_FS_RAMP - ramp the throttle from full to 0 over THR_FS_TIME
+ *   THR_FS_STOP - stop
+ */
+#define THR_FS_HOLD   0
+#define THR_FS_RAMP   1
+#define THR_FS_STOP   2
+
+#if !defined( THR_FAILSAFE )
+#define THR_FAILSAFE  THR_FS_RAMP
+#endif
+
+#define THR_LOSS_TMO  100  // ms
+#define THR_FS_TIME   1000 // ms
+
+#define THR_FS_RAMP_STEP  ( (THROTTLE_MAX + THR_FS_TIME - 1) / THR_FS_TIME )
+
+// throttle (with the default range) above which the range learn is started
+#define THR_LEARN_ARM    ( (THROTTLE_MAX / 4) * 3 )
+
+// the width must be steady for this long to be learned (ms)
+#define THR_LEARN_TIME   1500
+
+// steady tolerance and minimum learned span, relative to the default span
+#define THR_LEARN_TOL_SH   5
+#define THR_LEARN_SPAN_SH  2
+
+/*
+ * Capture classifications in addition to the protocols i.e. the pulse width
+ * is out of range of the present capture timebase.
+ */
+#define THR_TOO_SHORT  THR_NR_PROTO
+#define THR_TOO_LONG   (THR_NR_PROTO + 1)
+
+
+/* Private types -----------------------------------------------------------*/
+
+/**
+ * @brief Pulse width range of a protocol, in capture timer counts
+ */
+typedef struct
+{
+  uint16_t min;      /**< Width at zero throttle */
+  uint16_t max;      /**< Width at full throttle */
+  uint16_t scale;    /**< Fixed-point THROTTLE_MAX / (max - min), computed
+                          when the range is set, learned or loaded */
+  uint16_t win_min;  /**< Plausible width */
+  uint16_t win_max;
+  uint16_t perd_min; /**< Plausible period */
+  uint16_t perd_max;
+} thr_range_t;
+
+/**
+ * @brief Range learn states
+ */
+typedef enum
+{
+  LEARN_OFF,
+  LEARN_ARMED,   // waiting for the signal to qualify following reset
+  LEARN_HIGH,    // waiting for the maximum width to be steady
+  LEARN_LOW,     // waiting for the minimum width to be steady
+  LEARN_SAVE     // learned, waiting for the background task
+} thr_learn_state_t;
+
+/**
+ * @brief Learned range record, as stored in the EEPROM
+ */
+typedef struct
+{
+  uint16_t min;
+  uint16_t max;
+  uint8_t proto;
+} thr_learn_t;
+
+
+/* Private variables ---------------------------------------------------------*/
+
+// indexed by protocol
+static const thr_range_t Range_tb[THR_NR_PROTO] =
+{
+  // THR_NONE (unused)
+  THR_RANGE( 8, 16, 0, 0 ),
+  // THR_SERVO: 33 - 80 Hz (12.3 - 30 ms)
+  THR_RANGE( RF_PCNT_ZERO, RF_PCNT_100, RF_NORDO_THR, US_SLOW(30000) ),
+  // THR_ONESHOT125, OneShot42, Multishot: up to 4 kHz, 16 kHz, 32 kHz
+  THR_RANGE( US_FAST(125), US_FAST(250), US_FAST(250), THR_PERD_ANY ),
+  THR_RANGE( US_FAST(42), US_FAST(84), US_FAST(62), THR_PERD_ANY ),
+  THR_RANGE( US_FAST(5), US_FAST(25), US_FAST(31), THR_PERD_ANY )
+};
+
+static uint8_t Capture_fast;
+static uint8_t Detect_class = THR_NONE;
+static uint8_t Detect_count;
+
+static thr_proto_t Protocol = THR_NONE;
+static thr_range_t Range;      // range of the locked protocol
+
+static thr_learn_t Learned;
+static thr_range_t Learned_range;
+static uint8_t Learned_ok;
+
+static thr_learn_state_t Learn_state = LEARN_ARMED;
+static uint16_t Learn_ref;
+static uint16_t Learn_count;
+static uint16_t Dur_filt;      // filtered width of the latest good frame
+
+// previous 2 widths for the median filter
+static median3_t Dur_hist;
+
+static uint8_t  Good_count;
+static uint8_t  Frame_good;    // good frame since the previous update
+static uint16_t Throttle_in;   // throttle from the latest good frame
+
+static thr_signal_t Signal = THR_SIG_NONE;
+static uint16_t Loss_count;
+static uint16_t Throttle;      // output
+
+
+/* Private functions ---------------------------------------------------------*/
+
+/*
+ * Classify the pulse by width for the present capture timebase.
+ */
+static uint8_t classify(uint16_t dur)
+{
+  if (FALSE == Capture_fast)
+  {
+    if (dur < US_SLOW(THR_FAST_MAX_US))
+    {
+      return THR_TOO_SHORT;
+    }
+    return THR_SERVO;
+  }
+
+  if (dur > US_FAST(THR_FAST_MAX_US))
+  {
+    return THR_TOO_LONG;
+  }
+  if (dur > US_FAST(THR_OS125_MIN_US))
+  {
+    return THR_ONESHOT125;
+  }
+  if (dur > US_FAST(THR_OS42_MIN_US))
+  {
+    return THR_ONESHOT42;
+  }
+  return THR_MULTISHOT;
+}
+
+/*
+ * Apply the failsafe, called each update period once the signal is lost.
+ */
+static void failsafe(void)
+{
+#if THR_FAILSAFE == THR_FS_HOLD
+  if (Loss_count > (THR_LOSS_TMO + THR_FS_TIME))
+  {
+    Throttle = 0;
+  }
+#elif THR_FAILSAFE == THR_FS_RAMP
+  Throttle = (Throttle > THR_FS_RAMP_STEP) ? (Throttle - THR_FS_RAMP_STEP) : 0;
+#else
+  Throttle = 0;
+#endif
+}
+
+/*
+ * Range of a protocol from learned endpoints, returns FALSE if the span is not
+ * plausible for the protocol.
+ */
+static uint8_t make_range(thr_range_t * p_range, const thr_learn_t * p_learn)
+{
+  const thr_range_t * p_dflt;
+  uint16_t span;
+  uint16_t margin;
+
+  if (p_learn->proto <= THR_NONE  ||  p_learn->proto >= THR_NR_PROTO
+      ||  p_learn->max <= p_learn->min)
+  {
+    return FALSE;
+  }
+
+  p_dflt = &Range_tb[p_learn->proto];
+  span = p_learn->max - p_learn->min;
+
+  if (span < ((p_dflt->max - p_dflt->min) >> THR_LEARN_SPAN_SH))
+  {
+    return FALSE;
+  }
+
+  margin = span >> 3;
+
+  *p_range = *p_dflt; // period window
+  p_range->min = p_learn->min;
+  p_range->max = p_learn->max;
+  p_range->scale =
+    (uint16_t)( ( (uint32_t)THROTTLE_MAX << THR_SCALE_SH ) / span );
+  p_range->win_min = (p_learn->min > margin) ? (p_learn->min - margin) : 0;
+  p_range->win_max = (uint16_t)MIN16( (uint32_t)p_learn->max + margin, U16_MAX );
+
+  return TRUE;
+}
+
+/*
+ * Range of the locked protocol, the learned range if there is one.
+ */
+static void set_range(thr_proto_t proto)
+{
+  if (FALSE != Learned_ok  &&  (uint8_t)proto == Learned.proto)
+  {
+    Range = Learned_range;
+  }
+  else
+  {
+    Range = Range_tb[proto];
+  }
+}
+
+/*
+ * Range learn, called each update period while the signal is OK.
+ */
+static void learn(void)
+{
+  const thr_range_t * p_dflt = &Range_tb[Protocol];
+  uint16_t span = p_dflt->max - p_dflt->min;
+  uint16_t tol = span >> THR_LEARN_TOL_SH;
+  uint16_t dur = Dur_filt;
+
+  if (LEARN_HIGH != Learn_state  &&  LEARN_LOW != Learn_state)
+  {
+    return;
+  }
+
+  if ( dur > (Learn_ref + tol)  ||  (dur + tol) < Learn_ref )
+  {
+    // not steady, start over
+    Learn_ref = dur;
+    Learn_count = 0;
+    return;
+  }
+
+  if (LEARN_LOW == Learn_state  &&
+      (dur + (span >> THR_LEARN_SPAN_SH)) > Learned.max )
+  {
+    // throttle has not been lowered
+    Learn_count = 0;
+    return;
+  }
+
+  if (++Learn_count < THR_LEARN_TIME)
+  {
+    return;
+  }
+
+  Learn_count = 0;
+
+  if (LEARN_HIGH == Learn_state)
+  {
+    Learned.max = Learn_ref;
+    Learn_state = LEARN_LOW;
+  }
+  else
+  {
+    Learned.min = Learn_ref;
+    Learned.proto = (uint8_t)Protocol;
+    Learn_state = LEARN_SAVE;
+  }
+}
+
+/*
+ * Normalize pulse width to throttle (duty-cycle command).
+ */
+static uint16_t normalize(const thr_range_t * p_range, uint16_t dur)
+{
+  uint16_t width;
+
+  if (dur <= p_range->min)
+  {
+    return 0;
+  }
+
+  width = dur - p_range->min;
+
+  if (width >= (p_range->max - p_range->min))
+  {
+    return THROTTLE_MAX;
+  }
+  return (uint16_t)( ( (uint32_t)width * p_range->scale ) >> THR_SCALE_SH );
+}
+
+
+/* Public functions ---------------------------------------------------------*/
+
+/**
+ * @brief Process a captured throttle pulse.
+ *
+ * @details Called from the capture ISR on the falling edge. The protocol is
+ * locked once a number of consecutive pulses have the same classification, and
+ * pulses not matching the locked protocol are ignored. The period is checked
+ * only to reject pulses wider than 1/2 the period (i.e. inverted signal), as at
+ * prescaler 1 the period of slow frame rates (< 250 Hz) wraps the timer. A pulse
+ * out of range of the timebase is not checked, as the period is meaningless.
+ *
+ * @param perd  Capture counts from the previous rising edge
+ * @param dur   Capture counts from the rising edge
+ */
+void Throttle_on_pulse(uint16_t perd, uint16_t dur)
+{
+  uint8_t pclass = classify(dur);
+
+  if ( pclass < THR_NR_PROTO  &&  perd < (dur << 1) )
+  {
+    Detect_count = 0;
+    return;
+  }
+
+  if (pclass != Detect_class)
+  {
+    Detect_class = pclass;
+    Detect_count = 0;
+  }
+  else if (Detect_count < THR_DETECT_N)
+  {
+    Detect_count += 1;
+  }
+
+  if (Detect_count >= THR_DETECT_N)
+  {
+    if (THR_TOO_SHORT == pclass || THR_TOO_LONG == pclass)
+    {
+      // out of range of the timebase, switch and start over
+      Capture_fast = (THR_TOO_SHORT == pclass);
+      MCU_set_capture_fast(Capture_fast);
+
+      Detect_class = THR_NONE;
+      Detect_count = 0;
+      Protocol = THR_NONE;
+      Good_count = 0;
+      return;
+    }
+    if ((uint8_t)Protocol != pclass)
+    {
+      // new protocol, the filter history is in other units
+      Protocol = (thr_proto_t)pclass;
+      set_range(Protocol);
+      Median3_Reset(&Dur_hist);
+      Good_count = 0;
+    }
+  }
+
+  if ( (uint8_t)Protocol == pclass )
+  {
+    const thr_range_t * p_range = &Range;
+
+    // the width is not checked while learning, the endpoints are not known
+    if ( ( LEARN_OFF == Learn_state  &&
+           ( dur < p_range->win_min  ||  dur > p_range->win_max ) )
+         ||  perd < p_range->perd_min  ||  perd > p_range->perd_max )
+    {
+      Good_count = 0;
+      return;
+    }
+
+    if (Good_count < THR_GOOD_N)
+    {
+      Good_count += 1;
+    }
+
+    dur = Median3(&Dur_hist, dur);
+
+    if (Good_count >= THR_GOOD_N)
+    {
+      Dur_filt = dur;
+      Throttle_in = normalize( p_range, dur );
+      Frame_good = TRUE;
+    }
+  }
+}
+
+/**
+ * @brief Update the throttle signal state.
+ *
+ * @details Called at the control rate (ISR, ~1 ms). Passes on the throttle from
+ * the latest good frame, or counts the time since the last good frame and
+ * applies the failsafe once the signal is lost. Once the signal has qualified
+ * the throttle is applied to the BLDC speed setting here rather than from the
+ * background task, so a new frame takes effect at the next control tick.
+ */
+void Throttle_Update(void)
+{
+  if (FALSE != Frame_good)
+  {
+    Frame_good = FALSE;
+    Loss_count = 0;
+    Signal = THR_SIG_OK;
+
+    if (LEARN_ARMED == Learn_state)
+    {
+      // throttle high at power-up starts the range learn
+      Learn_state = (Throttle_in > THR_LEARN_ARM) ? LEARN_HIGH : LEARN_OFF;
+      Learn_ref = Dur_filt;
+      Learn_count = 0;
+    }
+  }
+  else if (THR_SIG_NONE != Signal  &&  Loss_count < U16_MAX)
+  {
+    Loss_count += 1;
+  }
+
+  if (Loss_count > THR_LOSS_TMO)
+  {
+    Signal = THR_SIG_LOST;
+
+    if (LEARN_HIGH == Learn_state  ||  LEARN_LOW == Learn_state)
+    {
+      Learn_state = LEARN_OFF; // abandon the learn, keep the present range
+    }
+    failsafe();
+  }
+  else if (THR_SIG_OK == Signal)
+  {
+    learn();
+
+    // motor is held stopped while learning
+    Throttle = (LEARN_OFF == Learn_state) ? Throttle_in : 0;
+  }
+
+  if (THR_SIG_NONE != Signal)
+  {
+    BLDC_PWMDC_Set(Throttle);
+  }
+}
+
+/**
+ * @brief Load the learned throttle range.
+ *
+ * @details Called once at startup, before interrupts are enabled.
+ */
+void Throttle_Init(void)
+{
+  Learned_ok = Eeprom_Load(EE_OFFS_THROTTLE, &Learned, sizeof(Learned));
+
+  if (FALSE != Learned_ok)
+  {
+    Learned_ok = make_range(&Learned_range, &Learned);
+  }
+}
+
+/**
+ * @brief Save the learned throttle range.
+ *
+ * @details Called from the background task, the EEPROM write blocks for a few
+ * ms per byte (the motor is stopped while learning). The learned range is
+ * applied to the locked protocol once saved.
+ *
+ * @return  TRUE if a learned range was saved
+ */
+uint8_t Throttle_Task(void)
+{
+  thr_range_t range;
+  uint8_t ok;
+
+  if (LEARN_SAVE != Learn_state)
+  {
+    return FALSE;
+  }
+
+  ok = make_range(&range, &Learned);
+
+  if (FALSE != ok)
+  {
+    ok = Eeprom_Save(EE_OFFS_THROTTLE, &Learned, sizeof(Learned));
+  }
+
+  disableInterrupts();
+  if (FALSE != ok)
+  {
+    Learned_range = range;
+    Learned_ok = TRUE;
+    set_range(Protocol);
+  }
+  Learn_state = LEARN_OFF;
+  enableInterrupts();
+
+  return ok;
+}
+
+/**
+ * @brief Accessor for normalized throttle.
+ *
+ * @return  Throttle, duty-cycle command [0:THROTTLE_MAX], 0 if no signal
+ */
+uint16_t Throttle_Get(void)
+{
+  return Throttle;
+}
+
+/**
+ * @brief Accessor for throttle signal state.
+ *
+ * @return  Signal state
+ */
+thr_signal_t Throttle_Get_signal(void)
+{
+  return Signal;
+}
+
+/**
+ * @brief Accessor for detected throttle protocol.
+ *
+ * @return  Protocol
+ */
+thr_proto_t Throttle_Get_protocol(void)
+{
+  return Protocol;
+}
+
+#endif // HAS_SERVO_INPUT
+
+/**@}*/ // defgroup
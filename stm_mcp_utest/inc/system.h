@@ -19,4 +19,21 @@
 
 #include <stdint.h>
 
+#define TRUE  1
+#define FALSE 0
+
+#define U16_MAX  UINT16_MAX
+
+// see system.h of the application
+#define CTIME_SCALAR 2
+
+#define CTRL_RATEM   4
+
+#define COMM_CNT_US           8
+#define COMM_QSECT_PER_CYCLE  24
+#define COMM_ERPM100_NUM      ( (600000UL * COMM_CNT_US) / COMM_QSECT_PER_CYCLE )
+
+#define DC_SH        8
+#define DC_100PCNT   ( (uint16_t)250 << DC_SH )  // 64000
+
 #endif // SYSTEM_H
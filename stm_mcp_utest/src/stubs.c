@@ -4,71 +4,73 @@
 
 #include <stdint.h>
 
-#include "driver.h"
+#include "system.h"
+#include "faultm.h"
 
 
-static uint16_t BLDC_OL_comm_tm;
-static BLDC_STATE_T BLDC_State;
-static uint16_t Vbatt;
-static int Manual_Mode;
-
-
-
-void TIM3_setup(uint16_t u16)
-{
-#ifdef DEBUG
-    // doesn't need to do anything so just show a message
-    printf("stubs::TIM3_setup((): $1 == %04X\n", u16);
-#endif
-}
+/*
+ * PWM: the duty-cycle is kept for the motor model of the test
+ */
+static uint16_t Dutycycle;
 
-void set_commutation_period(uint16_t u16)
+void set_dutycycle(uint16_t global_dutycycle)
 {
-    BLDC_OL_comm_tm = u16;
+    Dutycycle = global_dutycycle;
 }
 
-uint16_t get_commutation_period(void)
+uint16_t get_dutycycle(void)
 {
-    return BLDC_OL_comm_tm;
+    return Dutycycle;
 }
 
-BLDC_STATE_T get_bldc_state(void)
+void All_phase_stop(void)
 {
-    return BLDC_State;
+    Dutycycle = 0;
 }
 
-BLDC_STATE_T set_bldc_state( BLDC_STATE_T newstate)
-{
-    BLDC_State = newstate;
-}
+/*
+ * fault manager: the fault is set by the test, and cleared by init
+ */
+static fault_status_reg_t Fault_status;
 
-uint16_t get_vbatt(void)
+void set_fault_status(fault_status_reg_t status)
 {
-    return Vbatt;
+    Fault_status = status;
 }
 
-void set_vbatt(uint16_t u16)
+void Faultm_init(void)
 {
-    return Vbatt = u16;
+    Fault_status = 0;
 }
 
-int get_op_mode(void)
+fault_status_reg_t Faultm_get_status(void)
 {
-    return Manual_Mode;
+    return Fault_status;
 }
 
-void set_op_mode(int mode)
+/*
+ * throttle curve: linear
+ */
+uint16_t Thr_curve_Apply(uint16_t dc)
 {
-    Manual_Mode = mode;
+    return dc;
 }
 
-void set_dutycycle(uint16_t global_dutycycle)
+/*
+ * data EEPROM: nothing stored
+ */
+uint8_t Eeprom_Load(uint8_t offs, void * p_rec, uint8_t len)
 {
+    (void)offs;
+    (void)p_rec;
+    (void)len;
+    return 0;
 }
 
-uint16_t get_dutycycle(void)
+uint8_t Eeprom_Save(uint8_t offs, const void * p_rec, uint8_t len)
 {
+    (void)offs;
+    (void)p_rec;
+    (void)len;
+    return 0;
 }
-
-
-
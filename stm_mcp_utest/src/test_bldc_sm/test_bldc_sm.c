@@ -10,7 +10,7 @@
 /*
  * host system dependencies
  */
-// needs an suitable source of 'uint16_t' etc before #including driver.h
+#include <stdio.h>
 #include <stdint.h>
 
 /*
@@ -21,65 +21,297 @@
 /*
  * application headers ... external defines, types, declarations
  */
-#include "driver.h"
+#include "bldc_sm.h"
+#include "mdata.h"
+
+
+#include "faultm.h"
+
+
+uint16_t get_dutycycle(void); // stubs.c
+void set_fault_status(fault_status_reg_t status);
+
+
+/*
+ * motor model: the steady state commutation period at a duty-cycle is 15%
+ * longer than the open-loop table timing, and the speed follows the
+ * duty-cycle with a mechanical time constant
+ */
+#define SIM_TABLE_ERR     0.85
+#define SIM_TAU_TICKS     100.0
+
+// control ticks to start and get to closed-loop, and of each throttle step
+#define SIM_START_TICKS   5000
+#define SIM_STEP_TICKS    1000
+
+// commutation period limits (table timing at rest and at full speed)
+#define SIM_PERIOD_MIN    ( 0x006F * CTIME_SCALAR )
+#define SIM_PERIOD_MAX    ( 0x0B00 * CTIME_SCALAR )
+
+#define SIM_DC( _PCNT_ )  ( (uint16_t)( ( (uint32_t)(_PCNT_) * DC_100PCNT ) / 100 ) )
+
+
+static double Speed;     // 1 / motor period
+static double Period;    // motor period, in commutation timer counts
+
+
+/*
+ * sequencer: timing error of the back-EMF, positive if the commutation is
+ * advanced (period too short), ratio scaled by 64
+ */
+int16_t Seq_get_timing_error(void)
+{
+    double ratio;
+
+    if (0 == Speed)
+    {
+        return 0;
+    }
+    ratio = 64.0 * (Period - get_commutation_period()) / Period;
+
+    return (int16_t)( ratio > 64 ? 64 : (ratio < -64 ? -64 : ratio) );
+}
+
+// the back-EMF is not plausible with the motor stopped
+int8_t Seq_get_timing_error_p(void)
+{
+    return (0 == Speed) ? -1 : 0;
+}
+
+/*
+ * the motor model and the state machine for one control tick, at the speed
+ * input
+ */
+static void motor_tick(uint16_t dc_input)
+{
+    uint16_t dc = get_dutycycle();
+    double tgt = 0;
+
+    if (0 != dc)
+    {
+        tgt = SIM_TABLE_ERR / Get_OL_Timing(dc);
+    }
+
+    Speed += (tgt - Speed) / SIM_TAU_TICKS;
+    Period = (0 != Speed) ? (1.0 / Speed) : 0;
+
+    BLDC_PWMDC_Set(dc_input);
+    BLDC_Update();
+}
 
 
 /*
  * implements a test case iteration
  * this test case is to run the sm thru entire normal ramp-up until
- * state transitions to ON.
+ * state transitions to RUN and the commutation timing to closed-loop.
  */
 int test_case_1_iteration(void)
 {
-    static steps = 0; // local counter to track sequence in debug log output
-
-    BLDC_STATE_T bldc_state = get_bldc_state();
+    static int tick = 0;
 
-    BLDC_Update();
+    if (0 == tick)
+    {
+        BL_reset();
+    }
 
+    motor_tick( SIM_DC(30) );
 
-    bldc_state = get_bldc_state();
+    if (BL_ST_FAULT == BL_get_sm_state())
+    {
+        printf(" tick = %d fault\n", tick);
+        return TEST_FAIL;
+    }
 
-    if (BLDC_ON == bldc_state) // assert
+    if (BL_ST_RUN == BL_get_sm_state() && 0 != BL_get_ct_mode())
     {
         return TEST_DONE; // test iteration passed normally - stop sequence
     }
 
-    else if (BLDC_RAMPUP == bldc_state) // assert
+    if (++tick >= SIM_START_TICKS)
     {
-        uint16_t commutation_per = get_commutation_period();
-
-//#ifdef DEBUG
-// log this to the terminal in such a way it can be grabbed into a data file
-        printf(" commutation_per = %d %d %04X\n", steps, commutation_per, commutation_per);
-//#endif
-        steps += 1;
+        printf(" state = %u not closed-loop\n", BL_get_sm_state());
+        return TEST_FAIL;
     }
     // iteration completed normally
     return TEST_OK;
 }
 
+/*
+ * closed-loop commutation timing (timing_control) on the motor model with
+ * throttle steps: the period stays in range and converges on the motor period
+ * at each step
+ */
+int test_case_2_iteration(void)
+{
+    static const uint8_t dc_steps[] =
+    {
+        30, 60, 20, 55, 40
+    };
+    static int tick = 0;
+
+    uint16_t comm_tm;
+    double err;
+
+    motor_tick( SIM_DC( dc_steps[ tick / SIM_STEP_TICKS ] ) );
+
+    comm_tm = get_commutation_period();
+
+    if (BL_ST_RUN != BL_get_sm_state() ||
+            comm_tm < SIM_PERIOD_MIN || comm_tm > SIM_PERIOD_MAX)
+    {
+        printf(" tick = %d state = %u period = %u comm_tm = %u\n",
+               tick, BL_get_sm_state(), (unsigned)Period, comm_tm);
+        return TEST_FAIL;
+    }
+
+    tick += 1;
+
+    if (0 == (tick % SIM_STEP_TICKS))
+    {
+        // settled in closed-loop at the end of the step
+        err = (comm_tm > Period) ? (comm_tm - Period) : (Period - comm_tm);
+
+        if (0 == BL_get_ct_mode() || err > Period / 32)
+        {
+            printf(" tick = %d period = %u comm_tm = %u ct mode = %u not settled\n",
+                   tick, (unsigned)Period, comm_tm, BL_get_ct_mode());
+            return TEST_FAIL;
+        }
+        if (tick >= (int)(sizeof(dc_steps) / sizeof(dc_steps[0])) * SIM_STEP_TICKS)
+        {
+            return TEST_DONE;
+        }
+    }
+    return TEST_OK;
+}
+
+/*
+ * full throttle step, above the speed range of the table (the motor model is
+ * faster than LUDICROUS_SPEED): the period is held at the limit, no runaway
+ */
+int test_case_3_iteration(void)
+{
+    static int tick = 0;
+
+    uint16_t comm_tm;
+
+    motor_tick( DC_100PCNT );
+
+    comm_tm = get_commutation_period();
+
+    if (BL_ST_RUN != BL_get_sm_state() ||
+            comm_tm < SIM_PERIOD_MIN || comm_tm > SIM_PERIOD_MAX)
+    {
+        printf(" tick = %d state = %u period = %u comm_tm = %u\n",
+               tick, BL_get_sm_state(), (unsigned)Period, comm_tm);
+        return TEST_FAIL;
+    }
+
+    if (++tick >= SIM_STEP_TICKS)
+    {
+        if (SIM_PERIOD_MIN != comm_tm)
+        {
+            printf(" comm_tm = %u not at the limit\n", comm_tm);
+            return TEST_FAIL;
+        }
+        return TEST_DONE;
+    }
+    return TEST_OK;
+}
+
+/*
+ * fault while running: FAULT is held with the speed input up, and re-armed
+ * (RESET, READY) once the input is brought down, then READY is not re-entered
+ * every tick with the input held at 0
+ */
+int test_case_4_iteration(void)
+{
+    uint16_t n;
+
+    set_fault_status(VOLTAGE_NG);
+
+    for (n = 0; n < 100; n++)
+    {
+        motor_tick( SIM_DC(40) );
+
+        if (BL_ST_FAULT != BL_get_sm_state())
+        {
+            printf(" n = %u state = %u not in fault\n", n, BL_get_sm_state());
+            return TEST_FAIL;
+        }
+    }
+
+    motor_tick(0);
+    motor_tick(0);
+
+    if (BL_ST_READY != BL_get_sm_state())
+    {
+        printf(" state = %u not re-armed\n", BL_get_sm_state());
+        return TEST_FAIL;
+    }
+
+    for (n = 0; n < 100; n++)
+    {
+        motor_tick(0);
+    }
+
+    if (BL_ST_READY != BL_get_sm_state() || BL_get_state_time(BL_ST_READY) < 100)
+    {
+        printf(" state = %u time = %u\n",
+               BL_get_sm_state(), BL_get_state_time(BL_ST_READY));
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * fault with the speed input held at 0: not re-armed until the input is
+ * raised and brought down again
+ */
+int test_case_5_iteration(void)
+{
+    uint16_t n;
+
+    set_fault_status(VOLTAGE_NG);
+
+    for (n = 0; n < 100; n++)
+    {
+        motor_tick(0);
+    }
+
+    if (BL_ST_FAULT != BL_get_sm_state())
+    {
+        printf(" state = %u fault cleared with the input held low\n", BL_get_sm_state());
+        return TEST_FAIL;
+    }
+
+    motor_tick( SIM_DC(40) );
+    motor_tick(0);
+    motor_tick(0);
+
+    if (BL_ST_READY != BL_get_sm_state())
+    {
+        printf(" state = %u not re-armed\n", BL_get_sm_state());
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
 /*
  * top-level test_driver
  * generic name .. individual makefile will link the test_driver() implementation
  */
 void test_driver_1(void)
 {
-    /*
-     * this test case is to run the sm thru entire normal ramp-up until
-     * state transitions to ON.
-     */
-    set_bldc_state( BLDC_RAMPUP );
-
-    // set to the starting/off time (normally done by sm in the "OFF" state handler
-    set_commutation_period( /* BLDC_OL_TM_LO_SPD */ 0x1000 ); // todo: internal declaration in bldc_sm.c
+    putf_n_iterations(SIM_START_TICKS, &test_case_1_iteration, "test_case_1_iteration");
 
-// have to defeat diagnostics
-    set_vbatt(0xFFFF /* V_SHUTDOWN_THR */); // todo: internal declaration in bldc_sm.c
+    putf_n_iterations(5 * SIM_STEP_TICKS, &test_case_2_iteration, "test_case_2_iteration");
 
-    putf_n_iterations(10000, &test_case_1_iteration, "test_case_1_iteration");
+    putf_n_iterations(SIM_STEP_TICKS, &test_case_3_iteration, "test_case_3_iteration");
 
+    putf_n_iterations(1, &test_case_4_iteration, "test_case_4_iteration");
 
+    putf_n_iterations(1, &test_case_5_iteration, "test_case_5_iteration");
 }
 
 /*
@@ -89,6 +321,3 @@ void test_suite(void)
 {
     test_driver_1();
 }
-
-
-
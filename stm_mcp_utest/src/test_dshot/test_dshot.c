@@ -0,0 +1,212 @@
+/**
+  ******************************************************************************
+  * @file    test_dshot.c
+  * @brief   test driver for dshot.c
+  * @author  Neidermeier
+  * @version 1.0.0
+  * @date Oct-2026
+  ******************************************************************************
+  */
+/*
+ * host system dependencies
+ */
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * unit test framework headers
+ */
+#include "putf.h"
+
+/*
+ * application headers ... external defines, types, declarations
+ */
+#include "dshot.h"
+
+
+/*
+ * flight controller side of the telemetry response
+ */
+#define FC_TELEM_CRC_INV  0x0F
+#define FC_ERPM_MANT_BITS 9
+#define FC_ERPM_MANT_MAX  ( (1 << FC_ERPM_MANT_BITS) - 1 )
+
+// GCR code by nibble
+static const uint8_t Fc_gcr_tb[16] =
+{
+    0x19, 0x1B, 0x12, 0x13, 0x1D, 0x15, 0x16, 0x17,
+    0x1A, 0x09, 0x0A, 0x0B, 0x1E, 0x0D, 0x0E, 0x0F
+};
+
+/*
+ * decode the eRPM telemetry value to the electrical period in us
+ */
+static uint16_t fc_erpm_decode(uint16_t value)
+{
+    return (uint16_t)( (value & FC_ERPM_MANT_MAX) << (value >> FC_ERPM_MANT_BITS) );
+}
+
+/*
+ * decode the line levels (start bit in bit 20) to the 12-bit value, -1 if not
+ * valid GCR or the CRC does not match
+ */
+static int16_t fc_telem_decode(uint32_t line)
+{
+    uint32_t gcr = (line ^ (line >> 1)) & 0x000FFFFF;
+    uint16_t frame = 0;
+    uint8_t n;
+    uint8_t k;
+
+    for (n = 0; n < 4; n++)
+    {
+        uint8_t code = (uint8_t)( (gcr >> (15 - n * 5)) & 0x1F );
+
+        for (k = 0; k < 16 && Fc_gcr_tb[k] != code; k++)
+        {
+            ;
+        }
+        if (k >= 16)
+        {
+            return -1;
+        }
+        frame = (uint16_t)((frame << 4) | k);
+    }
+
+    if ( (Dshot_crc(frame >> 4) ^ FC_TELEM_CRC_INV) != (frame & 0x0F) )
+    {
+        return -1;
+    }
+    return (int16_t)(frame >> 4);
+}
+
+
+/*
+ * CRC known answer: throttle 1046 without telemetry request -> 0110
+ * (the makefile builds the bidirectional variant, so the frame CRC is inverted)
+ */
+int test_case_1_iteration(void)
+{
+    uint16_t frame = Dshot_encode(1046, 0);
+
+    if (0x06 != Dshot_crc(1046 << 1) || 0x09 != (frame & 0x0F))
+    {
+        printf(" crc = %X frame = %04X\n", Dshot_crc(1046 << 1), frame);
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * frame encode/decode round trip over all values and the telemetry bit, and a
+ * single bit error is always detected
+ */
+int test_case_2_iteration(void)
+{
+    static uint16_t n = 0;
+
+    uint16_t value = n >> 1;
+    uint8_t telem = (uint8_t)(n & 1);
+    uint8_t telem_rx = 0xFF;
+    uint16_t frame = Dshot_encode(value, telem);
+    uint8_t bit;
+
+    if ( (int16_t)value != Dshot_decode(frame, &telem_rx) || telem != telem_rx )
+    {
+        printf(" value = %d frame = %04X\n", value, frame);
+        return TEST_FAIL;
+    }
+
+    for (bit = 0; bit < DSHOT_FRAME_BITS; bit++)
+    {
+        if ( -1 != Dshot_decode(frame ^ (1 << bit), 0) )
+        {
+            printf(" value = %d bit = %d not detected\n", value, bit);
+            return TEST_FAIL;
+        }
+    }
+
+    if (++n >= ((DSHOT_THROTTLE_MAX + 1) * 2))
+    {
+        return TEST_DONE;
+    }
+    return TEST_OK;
+}
+
+/*
+ * eRPM telemetry round trip: the GCR line code decodes to the value sent, and
+ * the decoded period is within the resolution of the 9-bit mantissa
+ */
+int test_case_3_iteration(void)
+{
+    static uint32_t period = 0;
+
+    uint16_t value = Dshot_erpm_encode((uint16_t)period);
+    uint32_t line = Dshot_telem_encode(value);
+    int16_t rx = fc_telem_decode(line);
+    uint16_t period_rx;
+
+    if ( 0 != (line >> (DSHOT_TELEM_BITS - 1)) )
+    {
+        printf(" period = %u start bit not 0\n", (unsigned)period);
+        return TEST_FAIL;
+    }
+
+    if (rx != (int16_t)value)
+    {
+        printf(" period = %u value = %03X line = %06X rx = %d\n",
+               (unsigned)period, value, (unsigned)line, rx);
+        return TEST_FAIL;
+    }
+
+    period_rx = fc_erpm_decode((uint16_t)rx);
+
+    if (period_rx > period || (period - period_rx) > (period >> 8))
+    {
+        printf(" period = %u decoded = %u\n", (unsigned)period, period_rx);
+        return TEST_FAIL;
+    }
+
+    period += 1 + (period >> 6);
+
+    if (period > UINT16_MAX)
+    {
+        return TEST_DONE;
+    }
+    return TEST_OK;
+}
+
+/*
+ * stopped motor is reported as the maximum period
+ */
+int test_case_4_iteration(void)
+{
+    if (DSHOT_ERPM_STOPPED != Dshot_erpm_encode(UINT16_MAX))
+    {
+        printf(" stopped = %03X\n", Dshot_erpm_encode(UINT16_MAX));
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * top-level test_driver
+ */
+void test_driver_1(void)
+{
+    putf_n_iterations(1, &test_case_1_iteration, "test_case_1_iteration");
+
+    putf_n_iterations(
+        (DSHOT_THROTTLE_MAX + 1) * 2, &test_case_2_iteration, "test_case_2_iteration");
+
+    putf_n_iterations(10000, &test_case_3_iteration, "test_case_3_iteration");
+
+    putf_n_iterations(1, &test_case_4_iteration, "test_case_4_iteration");
+}
+
+/*
+ * generic implementation of test suite
+ */
+void test_suite(void)
+{
+    test_driver_1();
+}
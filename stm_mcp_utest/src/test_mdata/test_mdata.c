@@ -0,0 +1,231 @@
+/**
+  ******************************************************************************
+  * @file    test_mdata.c
+  * @brief   test driver for mdata.c (tuned open-loop timing table)
+  * @author  Neidermeier
+  * @version 1.0.0
+  * @date Oct-2026
+  ******************************************************************************
+  */
+/*
+ * host system dependencies
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * unit test framework headers
+ */
+#include "putf.h"
+
+/*
+ * application headers ... external defines, types, declarations
+ */
+#include "mdata.h"
+#include "eeprom.h"
+
+
+/*
+ * motor model: 20% slower than the ROM table, and a measurement of one knot
+ * is above the one preceding (out of order)
+ */
+#define SIM_SCALE_PCNT    120
+#define SIM_NOISE_KNOT    4
+#define SIM_NOISE         10
+
+// the largest step between table entries (ROM table, scaled)
+#define SIM_STEP_MAX      ( 2 * 32 * SIM_SCALE_PCNT / 100 )
+
+
+/*
+ * data EEPROM stub, one record
+ */
+static uint8_t Ee_rec[ 64 ];
+static uint8_t Ee_valid;
+
+uint8_t Eeprom_Load(uint8_t offs, void * p_rec, uint8_t len)
+{
+    (void)offs;
+    memcpy(p_rec, Ee_rec, len);
+    return Ee_valid;
+}
+
+uint8_t Eeprom_Save(uint8_t offs, const void * p_rec, uint8_t len)
+{
+    (void)offs;
+    memcpy(Ee_rec, p_rec, len);
+    Ee_valid = 1;
+    return 1;
+}
+
+
+static uint16_t Rom_tm[ OL_TUNE_KNOTS ];
+static uint16_t Motor_tm[ OL_TUNE_KNOTS ];
+
+
+/*
+ * nothing stored: the ROM table is used
+ */
+int test_case_1_iteration(void)
+{
+    uint8_t n;
+
+    Ee_valid = 0;
+    Mdata_Init();
+
+    if (0 != Mdata_Get(0))
+    {
+        printf(" tuned table without a record\n");
+        return TEST_FAIL;
+    }
+
+    for (n = 0; n < OL_TUNE_KNOTS; n++)
+    {
+        Rom_tm[n] = Get_OL_Timing( OL_TUNE_DC(n) );
+        Motor_tm[n] = (uint16_t)( ((uint32_t)Rom_tm[n] * SIM_SCALE_PCNT) / 100 );
+    }
+    return TEST_DONE;
+}
+
+/*
+ * tuned table: the knots out of order are pooled to their average, the table
+ * is on the motor at the other knots, and is non-increasing and continuous
+ * over the whole duty-cycle range
+ */
+int test_case_2_iteration(void)
+{
+    uint16_t knots[ OL_TUNE_KNOTS ];
+    uint16_t prev;
+    uint16_t tm;
+    uint16_t dc;
+    uint8_t n;
+
+    memcpy(knots, Motor_tm, sizeof(knots));
+    knots[ SIM_NOISE_KNOT ] = knots[ SIM_NOISE_KNOT - 1 ] + SIM_NOISE;
+
+    if (0 == Mdata_Set(knots))
+    {
+        printf(" tuned table not applied\n");
+        return TEST_FAIL;
+    }
+
+    for (n = 0; n < OL_TUNE_KNOTS; n++)
+    {
+        uint16_t expect = Motor_tm[n];
+
+        if (SIM_NOISE_KNOT == n || (SIM_NOISE_KNOT - 1) == n)
+        {
+            expect = Motor_tm[ SIM_NOISE_KNOT - 1 ] + (SIM_NOISE / 2);
+        }
+
+        tm = Get_OL_Timing( OL_TUNE_DC(n) );
+
+        if (tm != expect)
+        {
+            printf(" knot = %u tm = %u expect = %u\n", n, tm, expect);
+            return TEST_FAIL;
+        }
+    }
+
+    prev = Get_OL_Timing(0);
+
+    for (dc = 1; dc < OL_TUNE_DC_MAX + (16 << DC_SH); dc++)
+    {
+        tm = Get_OL_Timing(dc);
+
+        if (tm > prev + 1 || prev - tm > SIM_STEP_MAX)
+        {
+            printf(" dc = %u tm = %u prev = %u\n", dc, tm, prev);
+            return TEST_FAIL;
+        }
+        prev = tm;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * the inverse lookup is on the tuned table
+ */
+int test_case_3_iteration(void)
+{
+    uint8_t n;
+    uint16_t dc;
+
+    for (n = 0; n < OL_TUNE_KNOTS; n++)
+    {
+        dc = Get_OL_Dutycycle( Motor_tm[n] );
+
+        if (Get_OL_Timing(dc) > Motor_tm[n] || Get_OL_Timing(dc - 1) <= Motor_tm[n])
+        {
+            printf(" knot = %u dc = %u tm = %u\n", n, dc, Get_OL_Timing(dc));
+            return TEST_FAIL;
+        }
+    }
+    return TEST_DONE;
+}
+
+/*
+ * saved table is loaded at startup, cleared reverts to the ROM table, and an
+ * implausible table is not applied
+ */
+int test_case_4_iteration(void)
+{
+    uint16_t knots[ OL_TUNE_KNOTS ];
+    uint16_t tm = Get_OL_Timing( OL_TUNE_DC(1) );
+    uint8_t n;
+
+    Mdata_Save();
+    Mdata_Clear();
+    Mdata_Init();
+
+    if (0 != Mdata_Get(0) || Rom_tm[1] != Get_OL_Timing( OL_TUNE_DC(1) ))
+    {
+        printf(" not cleared\n");
+        return TEST_FAIL;
+    }
+
+    Mdata_Set(Motor_tm);
+    Mdata_Save();
+    Mdata_Set(Rom_tm);
+    Mdata_Init();
+
+    if (Motor_tm[0] != Mdata_Get(0) || tm != Get_OL_Timing( OL_TUNE_DC(1) ))
+    {
+        printf(" not loaded\n");
+        return TEST_FAIL;
+    }
+
+    for (n = 0; n < OL_TUNE_KNOTS; n++)
+    {
+        knots[n] = Rom_tm[n] * 5; // more than 4x the ROM table
+    }
+    if (0 != Mdata_Set(knots) || Motor_tm[0] != Mdata_Get(0))
+    {
+        printf(" implausible table applied\n");
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * top-level test_driver
+ */
+void test_driver_1(void)
+{
+    putf_n_iterations(1, &test_case_1_iteration, "test_case_1_iteration");
+
+    putf_n_iterations(1, &test_case_2_iteration, "test_case_2_iteration");
+
+    putf_n_iterations(1, &test_case_3_iteration, "test_case_3_iteration");
+
+    putf_n_iterations(1, &test_case_4_iteration, "test_case_4_iteration");
+}
+
+/*
+ * generic implementation of test suite
+ */
+void test_suite(void)
+{
+    test_driver_1();
+}
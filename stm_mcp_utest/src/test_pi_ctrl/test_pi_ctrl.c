@@ -0,0 +1,116 @@
+/**
+  ******************************************************************************
+  * @file    test_pi_ctrl.c
+  * @brief   test driver for pi_ctrl.c
+  * @author  Neidermeier
+  * @version 1.0.0
+  * @date Oct-2026
+  ******************************************************************************
+  */
+/*
+ * host system dependencies
+ */
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * unit test framework headers
+ */
+#include "putf.h"
+
+/*
+ * application headers ... external defines, types, declarations
+ */
+#include "pi_ctrl.h"
+
+
+static pi_ctrl_t Pi;
+
+
+/*
+ * bumpless reset: output with zero error is the preset value, within limits
+ */
+int test_case_1_iteration(void)
+{
+    Pi.kp = 256;
+    Pi.ki = 64;
+    Pi.out_min = -100;
+    Pi.out_max = 100;
+
+    PI_ctrl_Reset(&Pi, 37);
+
+    if (37 != PI_ctrl_Update(&Pi, 0))
+    {
+        printf(" preset 37 out = %d\n", PI_ctrl_Update(&Pi, 0));
+        return TEST_FAIL;
+    }
+
+    PI_ctrl_Reset(&Pi, -1000);
+
+    if (-100 != PI_ctrl_Update(&Pi, 0))
+    {
+        printf(" preset -1000 out = %d\n", PI_ctrl_Update(&Pi, 0));
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * anti-windup: after a long time saturated, the output comes off the limit
+ * at the first update with the error reversed
+ */
+int test_case_2_iteration(void)
+{
+    static int n = 0;
+
+    int16_t out;
+
+    if (0 == n)
+    {
+        Pi.kp = 256;
+        Pi.ki = 64;
+        Pi.out_min = -100;
+        Pi.out_max = 100;
+        PI_ctrl_Reset(&Pi, 0);
+    }
+
+    if (n < 999)
+    {
+        out = PI_ctrl_Update(&Pi, 1000);
+
+        if (out > 100 || (n > 400 && 100 != out))
+        {
+            printf(" n = %d out = %d\n", n, out);
+            return TEST_FAIL;
+        }
+        n += 1;
+        return TEST_OK;
+    }
+
+    out = PI_ctrl_Update(&Pi, -1);
+
+    if (out >= 100)
+    {
+        printf(" reversed out = %d\n", out);
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * top-level test_driver
+ */
+void test_driver_1(void)
+{
+    putf_n_iterations(1, &test_case_1_iteration, "test_case_1_iteration");
+
+    putf_n_iterations(1000, &test_case_2_iteration, "test_case_2_iteration");
+}
+
+/*
+ * generic implementation of test suite
+ */
+void test_suite(void)
+{
+    test_driver_1();
+}
@@ -0,0 +1,225 @@
+/**
+  ******************************************************************************
+  * @file    test_throttle.c
+  * @brief   test driver for throttle.c (servo pulse input)
+  * @author  Neidermeier
+  * @version 1.0.0
+  * @date Oct-2026
+  ******************************************************************************
+  */
+/*
+ * host system dependencies
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * unit test framework headers
+ */
+#include "putf.h"
+
+/*
+ * application headers ... external defines, types, declarations
+ */
+#include "throttle.h"
+
+
+/*
+ * frames measured with the developer radio (capture counts, prescaler 32)
+ */
+#define RF_PERD        0x55C0  // receiving
+#define RF_PERD_NORDO  0x2BB0  // transmitter off
+#define RF_PCNT_ZERO   0x044A
+#define RF_PCNT_100    0x0768
+
+// control ticks (~1 ms) per frame
+#define FRAME_TICKS    22
+
+// frames to qualify: protocol detect and good frames, with margin
+#define FRAMES_QUAL    20
+
+// full throttle applied to the duty-cycle
+#define DC_FULL  THROTTLE_MAX
+
+
+/*
+ * stubs
+ */
+static uint16_t Dc;
+static uint16_t Dc_count;
+static uint8_t Capture_fast;
+
+void BLDC_PWMDC_Set(uint16_t dc)
+{
+    Dc = dc;
+    Dc_count += 1;
+}
+
+void MCU_set_capture_fast(uint8_t fast)
+{
+    Capture_fast = fast;
+}
+
+uint8_t Eeprom_Load(uint8_t offs, void * p_rec, uint8_t len)
+{
+    (void)offs;
+    (void)p_rec;
+    (void)len;
+    return 0; // no learned range
+}
+
+uint8_t Eeprom_Save(uint8_t offs, const void * p_rec, uint8_t len)
+{
+    (void)offs;
+    (void)p_rec;
+    (void)len;
+    return 1;
+}
+
+
+/*
+ * one frame from the receiver, and the control ticks until the next
+ */
+static void frame(uint16_t perd, uint16_t dur)
+{
+    uint8_t n;
+
+    Throttle_on_pulse(perd, dur);
+
+    for (n = 0; n < FRAME_TICKS; n++)
+    {
+        Throttle_Update();
+    }
+}
+
+
+/*
+ * transmitter off: the frames of 0x2BB0 never qualify, and the throttle is
+ * never applied
+ */
+int test_case_1_iteration(void)
+{
+    uint8_t n;
+
+    Throttle_Init();
+
+    for (n = 0; n < 100; n++)
+    {
+        frame(RF_PERD_NORDO, (n & 1) ? RF_PCNT_100 : RF_PCNT_ZERO);
+    }
+
+    if (THR_SIG_NONE != Throttle_Get_signal() || 0 != Dc_count)
+    {
+        printf(" signal = %u dc count = %u\n", Throttle_Get_signal(), Dc_count);
+        return TEST_FAIL;
+    }
+    if (0 != Capture_fast)
+    {
+        printf(" switched to fast capture\n");
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * receiving, zero throttle: the signal qualifies on the servo protocol and the
+ * throttle is 0 (so the range learn is not started)
+ */
+int test_case_2_iteration(void)
+{
+    uint8_t n;
+
+    for (n = 0; n < FRAMES_QUAL; n++)
+    {
+        frame(RF_PERD, RF_PCNT_ZERO);
+    }
+
+    if (THR_SIG_OK != Throttle_Get_signal() ||
+            THR_SERVO != Throttle_Get_protocol())
+    {
+        printf(" signal = %u protocol = %u\n",
+               Throttle_Get_signal(), Throttle_Get_protocol());
+        return TEST_FAIL;
+    }
+    if (0 == Dc_count || 0 != Dc || 0 != Throttle_Get())
+    {
+        printf(" dc = %u throttle = %u\n", Dc, Throttle_Get());
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * receiving, full and 1/2 throttle are applied to the duty-cycle
+ */
+int test_case_3_iteration(void)
+{
+    uint16_t half = (RF_PCNT_ZERO + RF_PCNT_100) / 2;
+    uint8_t n;
+
+    for (n = 0; n < 4; n++)
+    {
+        frame(RF_PERD, RF_PCNT_100);
+    }
+    if (DC_FULL != Dc)
+    {
+        printf(" full: dc = %u expect = %u\n", Dc, DC_FULL);
+        return TEST_FAIL;
+    }
+
+    for (n = 0; n < 4; n++)
+    {
+        frame(RF_PERD, half);
+    }
+    if (Dc < (DC_100PCNT / 2) - (DC_100PCNT / 100) ||
+            Dc > (DC_100PCNT / 2) + (DC_100PCNT / 100))
+    {
+        printf(" half: dc = %u\n", Dc);
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * transmitter switched off: the 0x2BB0 frames are not good frames, so the
+ * signal is lost and the failsafe ramps the throttle to 0
+ */
+int test_case_4_iteration(void)
+{
+    uint16_t n;
+
+    for (n = 0; n < 100; n++)
+    {
+        frame(RF_PERD_NORDO, RF_PCNT_100);
+    }
+
+    if (THR_SIG_LOST != Throttle_Get_signal() || 0 != Dc)
+    {
+        printf(" signal = %u dc = %u\n", Throttle_Get_signal(), Dc);
+        return TEST_FAIL;
+    }
+    return TEST_DONE;
+}
+
+/*
+ * top-level test_driver
+ */
+void test_driver_1(void)
+{
+    putf_n_iterations(1, &test_case_1_iteration, "test_case_1_iteration");
+
+    putf_n_iterations(1, &test_case_2_iteration, "test_case_2_iteration");
+
+    putf_n_iterations(1, &test_case_3_iteration, "test_case_3_iteration");
+
+    putf_n_iterations(1, &test_case_4_iteration, "test_case_4_iteration");
+}
+
+/*
+ * generic implementation of test suite
+ */
+void test_suite(void)
+{
+    test_driver_1();
+}
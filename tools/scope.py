@@ -0,0 +1,132 @@
+#!/usr/bin/env python3
+"""
+Host side of the back-EMF capture (src/scope.c, SCOPE_ENABLED).
+
+Reads a capture streamed by the target from the serial port (or from a log file
+saved from a terminal), and reconstructs the phase voltages against electrical
+angle. Only phase A is sampled (ADC channel 0): phases B and C are phase A
+shifted by 120 and 240 degrees, which holds for a symmetrically wound motor at
+steady speed.
+
+Arm the capture from the terminal first: 'f' fault, 's' step, 'e' error trigger.
+
+usage:
+  scope.py /dev/ttyUSB0 [--baud 115200] [--csv out.csv] [--plot]
+  scope.py capture.log [--csv out.csv] [--plot]
+"""
+import argparse
+import os
+import sys
+
+# commutation timer counts per 1/4 sector are reported in the header (CT), the
+# sector is 60 electrical degrees
+SECTOR_DEG = 60
+QSECTORS = 4
+NSTEPS = 6
+
+# phase A state by commutation step (see sequence.c)
+PHASE_A_STATE = ['HI', 'HI', 'FLOAT_F', 'LO', 'LO', 'FLOAT_R']
+
+
+def read_lines(src, baud):
+    if os.path.exists(src) and not src.startswith('/dev/') and not src.upper().startswith('COM'):
+        with open(src) as f:
+            for line in f:
+                yield line
+        return
+    import serial  # pyserial, only needed for live capture
+    with serial.Serial(src, baud, timeout=10) as port:
+        while True:
+            raw = port.readline()
+            if not raw:
+                return
+            yield raw.decode('ascii', 'replace')
+
+
+def parse_capture(lines):
+    """Returns (header dict, [(step, tstamp, adc)]) of the first complete capture."""
+    hdr = None
+    samples = []
+    for line in lines:
+        line = line.strip()
+        if line.startswith('#SCOPE'):
+            hdr = dict(kv.split('=') for kv in line.split()[1:])
+            hdr = {k: int(v, 16) if k == 'CT' else int(v) for k, v in hdr.items()}
+            samples = []
+        elif line.startswith('#END'):
+            if hdr is not None:
+                return hdr, samples
+        elif hdr is not None and line:
+            try:
+                step, tstamp, adc = line.split()
+                samples.append((int(step), int(tstamp, 16), int(adc, 16)))
+            except ValueError:
+                pass  # interleaved terminal output
+    raise SystemExit('no complete capture found')
+
+
+def reconstruct(hdr, samples):
+    """Unwraps the electrical angle and returns rows of (angle, A, B, C, step, state)."""
+    sector_cts = hdr['CT'] * QSECTORS
+    rows = []
+    turns = 0
+    prev_step = None
+    for step, tstamp, adc in samples:
+        if prev_step is not None and step < prev_step:
+            turns += 1
+        prev_step = step
+        angle = (turns * NSTEPS + step) * SECTOR_DEG + SECTOR_DEG * tstamp / sector_cts
+        rows.append([angle, adc, step, PHASE_A_STATE[step % NSTEPS]])
+
+    # B lags A by 120 degrees, C by 240: take A at (angle - 120), (angle - 240)
+    def phase_at(angle):
+        best = min(rows, key=lambda r: abs(r[0] - angle))
+        return best[1] if abs(best[0] - angle) < SECTOR_DEG / QSECTORS else None
+
+    out = []
+    for angle, adc, step, state in rows:
+        out.append((angle, adc, phase_at(angle - 120), phase_at(angle - 240), step, state))
+    return out
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('src', help='serial port or capture log file')
+    ap.add_argument('--baud', type=int, default=115200)
+    ap.add_argument('--csv', help='write reconstructed waveform to CSV')
+    ap.add_argument('--plot', action='store_true', help='plot with matplotlib')
+    args = ap.parse_args()
+
+    hdr, samples = parse_capture(read_lines(args.src, args.baud))
+    if len(samples) != hdr['N']:
+        print('warning: %d of %d samples received' % (len(samples), hdr['N']), file=sys.stderr)
+    rows = reconstruct(hdr, samples)
+    trig_angle = rows[hdr['PRE'] - 1][0] if len(rows) >= hdr['PRE'] else None
+
+    fmt = lambda v: '' if v is None else str(v)
+    lines = ['angle,A,B,C,step,A_state']
+    lines += ['%.1f,%s,%s,%s,%d,%s' % (a, fmt(pa), fmt(pb), fmt(pc), st, s) for a, pa, pb, pc, st, s in rows]
+    if args.csv:
+        with open(args.csv, 'w') as f:
+            f.write('\n'.join(lines) + '\n')
+    else:
+        print('\n'.join(lines))
+
+    if args.plot:
+        import matplotlib.pyplot as plt
+        angle = [r[0] for r in rows]
+        for i, name in ((1, 'A'), (2, 'B'), (3, 'C')):
+            pts = [(a, r[i]) for a, r in zip(angle, rows) if r[i] is not None]
+            plt.plot([p[0] for p in pts], [p[1] for p in pts], '.-', label=name)
+        if trig_angle is not None:
+            plt.axvline(trig_angle, color='k', linestyle='--', label='trigger')
+        plt.xlabel('electrical angle (deg)')
+        plt.ylabel('ADC counts')
+        plt.title('trigger %d, comm period 0x%04X' % (hdr['TRG'], hdr['CT']))
+        plt.legend()
+        plt.grid(True)
+        plt.show()
+
+
+if __name__ == '__main__':
+    main()